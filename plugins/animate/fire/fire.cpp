@@ -6,9 +6,6 @@
 #include <wayfire/core.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-static wf::option_wrapper_t<int> fire_particles{"animate/fire_particles"};
-static wf::option_wrapper_t<double> fire_particle_size{"animate/fire_particle_size"};
-
 // generate a random float between s and e
 static float random(float s, float e)
 {
@@ -17,17 +14,22 @@ static float random(float s, float e)
     return (s * r + (1 - r) * e);
 }
 
-static int particle_count_for_width(int width)
-{
-    int particles = fire_particles;
-
-    return particles * std::min(width / 400.0, 3.5);
-}
-
 class FireTransformer : public wf::view_transformer_t
 {
     wf::geometry_t last_boundingbox;
 
+    /* These are members rather than globals, so that loading the plugin
+     * doesn't access the configuration */
+    wf::option_wrapper_t<int> fire_particles{"animate/fire_particles"};
+    wf::option_wrapper_t<double> fire_particle_size{"animate/fire_particle_size"};
+
+    int particle_count_for_width(int width)
+    {
+        int particles = fire_particles;
+
+        return particles * std::min(width / 400.0, 3.5);
+    }
+
   public:
     ParticleSystem ps;
 
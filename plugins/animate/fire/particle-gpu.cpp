@@ -0,0 +1,235 @@
+#include "particle-gpu.hpp"
+#include "shaders.hpp"
+#include <wayfire/util/log.hpp>
+#include <cstddef>
+#include <cstdio>
+
+static bool gl_has_transform_feedback()
+{
+    auto version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (!version ||
+        (std::sscanf(version, "OpenGL ES %d.%d", &major, &minor) != 2))
+    {
+        return false;
+    }
+
+    return major >= 3;
+}
+
+std::unique_ptr<ParticleSystemGPU> ParticleSystemGPU::create()
+{
+    if (!gl_has_transform_feedback())
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<ParticleSystemGPU> gpu(new ParticleSystemGPU());
+    if (!gpu->create_program())
+    {
+        return nullptr;
+    }
+
+    return gpu;
+}
+
+ParticleSystemGPU::~ParticleSystemGPU()
+{
+    if (buffer[0])
+    {
+        GL_CALL(glDeleteBuffers(2, buffer));
+    }
+
+    if (simulate_program)
+    {
+        GL_CALL(glDeleteProgram(simulate_program));
+    }
+}
+
+bool ParticleSystemGPU::create_program()
+{
+    auto vs = OpenGL::compile_shader(particle_simulate_vert_source,
+        GL_VERTEX_SHADER);
+    auto fs = OpenGL::compile_shader(particle_simulate_frag_source,
+        GL_FRAGMENT_SHADER);
+    if ((vs == (GLuint)-1) || (fs == (GLuint)-1))
+    {
+        return false;
+    }
+
+    simulate_program = GL_CALL(glCreateProgram());
+    GL_CALL(glAttachShader(simulate_program, vs));
+    GL_CALL(glAttachShader(simulate_program, fs));
+
+    static const char *varyings[] = {
+        "tf_life", "tf_fade", "tf_base_radius", "tf_radius",
+        "tf_pos", "tf_speed", "tf_g", "tf_start_x", "tf_color",
+    };
+    GL_CALL(glTransformFeedbackVaryings(simulate_program,
+        sizeof(varyings) / sizeof(varyings[0]), varyings,
+        GL_INTERLEAVED_ATTRIBS));
+    GL_CALL(glLinkProgram(simulate_program));
+
+    /* won't be really deleted until program is deleted as well */
+    GL_CALL(glDeleteShader(vs));
+    GL_CALL(glDeleteShader(fs));
+
+    GLint status;
+    GL_CALL(glGetProgramiv(simulate_program, GL_LINK_STATUS, &status));
+    if (status == GL_FALSE)
+    {
+        LOGE("Failed to link the fire particle simulation program, ",
+            "falling back to CPU simulation");
+        return false;
+    }
+
+    return true;
+}
+
+void ParticleSystemGPU::resize(int num)
+{
+    if (num == num_particles)
+    {
+        return;
+    }
+
+    /* value-initialized particles are dead */
+    std::vector<gpu_particle_t> initial(num);
+
+    GLuint new_buffer[2];
+    GL_CALL(glGenBuffers(2, new_buffer));
+    for (auto b : new_buffer)
+    {
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, b));
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, num * sizeof(gpu_particle_t),
+            initial.data(), GL_DYNAMIC_COPY));
+    }
+
+    if (buffer[0])
+    {
+        /* Keep the surviving particles. Both new buffers get the latest
+         * state, so that they agree on which particles are alive. */
+        int keep = std::min(num, num_particles);
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, buffer[current]));
+        for (auto b : new_buffer)
+        {
+            GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, b));
+            GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                0, 0, keep * sizeof(gpu_particle_t)));
+        }
+
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+        GL_CALL(glDeleteBuffers(2, buffer));
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    buffer[0] = new_buffer[0];
+    buffer[1] = new_buffer[1];
+    current   = 0;
+    num_particles = num;
+}
+
+void ParticleSystemGPU::set_particles(int first,
+    const std::vector<Particle>& particles)
+{
+    std::vector<gpu_particle_t> data(particles.size());
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        const auto& p = particles[i];
+        data[i] = {
+            p.life, p.fade, p.base_radius, p.radius,
+            {p.pos.x, p.pos.y}, {p.speed.x, p.speed.y}, {p.g.x, p.g.y},
+            p.start_pos.x,
+            {p.color.r, p.color.g, p.color.b, p.color.a},
+        };
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer[current]));
+    GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(gpu_particle_t),
+        data.size() * sizeof(gpu_particle_t), data.data()));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+void ParticleSystemGPU::set_simulate_attributes(bool enable)
+{
+    struct attribute_t
+    {
+        const char *name;
+        int size;
+        size_t offset;
+    };
+
+    static const attribute_t attributes[] = {
+        {"life", 1, offsetof(gpu_particle_t, life)},
+        {"fade", 1, offsetof(gpu_particle_t, fade)},
+        {"base_radius", 1, offsetof(gpu_particle_t, base_radius)},
+        {"radius", 1, offsetof(gpu_particle_t, radius)},
+        {"pos", 2, offsetof(gpu_particle_t, pos)},
+        {"speed", 2, offsetof(gpu_particle_t, speed)},
+        {"g", 2, offsetof(gpu_particle_t, g)},
+        {"start_x", 1, offsetof(gpu_particle_t, start_x)},
+        {"color", 4, offsetof(gpu_particle_t, color)},
+    };
+
+    for (const auto& attr : attributes)
+    {
+        GLint loc = GL_CALL(glGetAttribLocation(simulate_program, attr.name));
+        if (loc < 0)
+        {
+            continue;
+        }
+
+        if (enable)
+        {
+            GL_CALL(glEnableVertexAttribArray(loc));
+            GL_CALL(glVertexAttribPointer(loc, attr.size, GL_FLOAT, GL_FALSE,
+                sizeof(gpu_particle_t), (void*)attr.offset));
+        } else
+        {
+            GL_CALL(glDisableVertexAttribArray(loc));
+        }
+    }
+}
+
+void ParticleSystemGPU::update(int count)
+{
+    count = std::min(count, num_particles);
+    if (count <= 0)
+    {
+        return;
+    }
+
+    const int next = 1 - current;
+
+    GL_CALL(glUseProgram(simulate_program));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer[current]));
+    set_simulate_attributes(true);
+    GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer[next]));
+
+    /* Nothing is drawn, we only need the vertex shader outputs */
+    GL_CALL(glEnable(GL_RASTERIZER_DISCARD));
+    GL_CALL(glBeginTransformFeedback(GL_POINTS));
+    GL_CALL(glDrawArrays(GL_POINTS, 0, count));
+    GL_CALL(glEndTransformFeedback());
+    GL_CALL(glDisable(GL_RASTERIZER_DISCARD));
+
+    GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+    set_simulate_attributes(false);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GL_CALL(glUseProgram(0));
+
+    current = next;
+}
+
+void ParticleSystemGPU::bind_render_attributes(OpenGL::program_t& program)
+{
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer[current]));
+    program.attrib_pointer("radius", 1, sizeof(gpu_particle_t),
+        (void*)offsetof(gpu_particle_t, radius));
+    program.attrib_pointer("center", 2, sizeof(gpu_particle_t),
+        (void*)offsetof(gpu_particle_t, pos));
+    program.attrib_pointer("color", 4, sizeof(gpu_particle_t),
+        (void*)offsetof(gpu_particle_t, color));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
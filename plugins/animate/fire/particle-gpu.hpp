@@ -0,0 +1,66 @@
+#ifndef ANIMATION_FIRE_PARTICLE_GPU_HPP
+#define ANIMATION_FIRE_PARTICLE_GPU_HPP
+
+#include "particle.hpp"
+#include <memory>
+
+/**
+ * Particle state which lives in GPU buffers and is simulated with transform
+ * feedback, so that it doesn't have to be updated and uploaded by the CPU
+ * each frame.
+ *
+ * The state is kept in two buffers: each update reads one and writes the
+ * other. Slots which are not updated keep their old contents, so the user
+ * has to make sure that all particles in the updated range are either alive
+ * or dead in both buffers.
+ *
+ * All functions have to be called with a bound GL context.
+ */
+class ParticleSystemGPU
+{
+  public:
+    /**
+     * Create the GPU particle state.
+     *
+     * @return The new state, or nullptr if the GL context doesn't support
+     *   transform feedback (it needs OpenGL ES 3.0).
+     */
+    static std::unique_ptr<ParticleSystemGPU> create();
+    ~ParticleSystemGPU();
+
+    /* change the number of particles. New particles are dead */
+    void resize(int num);
+
+    /* overwrite the particles starting at index first */
+    void set_particles(int first, const std::vector<Particle>& particles);
+
+    /* update the first count particles */
+    void update(int count);
+
+    /* set up the attributes radius, center and color of the given program
+     * so that they point to the current particle state */
+    void bind_render_attributes(OpenGL::program_t& program);
+
+  private:
+    /* the GPU state of a single particle, in the order of the transform
+     * feedback varyings of the simulation shader */
+    struct gpu_particle_t
+    {
+        float life, fade, base_radius, radius;
+        float pos[2], speed[2], g[2];
+        float start_x;
+        float color[4];
+    };
+
+    int num_particles = 0;
+    /* buffer[current] contains the latest state */
+    GLuint buffer[2] = {0, 0};
+    int current = 0;
+
+    GLuint simulate_program = 0;
+    ParticleSystemGPU() = default;
+    bool create_program();
+    void set_simulate_attributes(bool enable);
+};
+
+#endif /* end of include guard: ANIMATION_FIRE_PARTICLE_GPU_HPP */
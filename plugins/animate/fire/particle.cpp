@@ -1,71 +1,134 @@
 #include "particle.hpp"
+#include "particle-gpu.hpp"
 #include "shaders.hpp"
 #include <wayfire/core.hpp>
-#include <thread>
+#include <wayfire/thread-pool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-void Particle::update(float time)
+ParticleSystem::ParticleSystem(int particles, ParticleIniter init_func)
 {
-    if (life <= 0) // ignore
-    {
-        return;
-    }
+    this->pinit_func = init_func;
 
-    const float slowdown = 0.8;
+    particles_alive.store(0);
+    create_program();
+    resize(particles);
+    last_update_msec = wf::get_current_time();
+}
 
-    pos   += speed * 0.2f * slowdown;
-    speed += g * 0.3f * slowdown;
+ParticleSystem::~ParticleSystem()
+{
+    OpenGL::render_begin();
+    gpu.reset();
+    program.free_resources();
+    OpenGL::render_end();
+}
 
-    if (life != 0)
+void ParticleSystem::set_particle(int i, const Particle& p)
+{
+    life[i] = p.life;
+    fade[i] = p.fade;
+    base_radius[i] = p.base_radius;
+    radius[i] = p.radius;
+
+    center[2 * i]     = p.pos.x;
+    center[2 * i + 1] = p.pos.y;
+    speed_x[i] = p.speed.x;
+    speed_y[i] = p.speed.y;
+    g_x[i]     = p.g.x;
+    g_y[i]     = p.g.y;
+    start_x[i] = p.start_pos.x;
+
+    for (int j = 0; j < color_per_particle; j++)
     {
-        color.a /= life;
+        color[4 * i + j] = p.color[j];
     }
+}
 
-    life    -= fade * 0.3 * slowdown;
-    radius   = base_radius * std::pow(life, 0.5);
-    color.a *= life;
-
-    if (start_pos.x < pos.x)
-    {
-        g.x = -1;
-    } else
+/* The number of updates after which the particle dies, see update_worker() */
+static uint64_t updates_to_live(const Particle& p)
+{
+    const float step = p.fade * 0.3f * 0.8f;
+    if (p.life <= 0)
     {
-        g.x = 1;
+        return 0;
     }
 
-    if (life <= 0)
+    if (step <= 0)
     {
-        /* move outside */
-        pos = {-10000, -10000};
+        return std::numeric_limits<uint32_t>::max();
     }
+
+    return std::ceil(p.life / step);
 }
 
-ParticleSystem::ParticleSystem(int particles, ParticleIniter init_func)
+int ParticleSystem::spawn_gpu(int num)
 {
-    this->pinit_func = init_func;
+    int spawned = 0;
 
-    resize(particles);
-    last_update_msec = wf::get_current_time();
-    create_program();
+    /* Spawned particles are uploaded in runs of consecutive indices */
+    std::vector<Particle> run;
+    int run_start = 0;
 
-    particles_alive.store(0);
-}
-
-ParticleSystem::~ParticleSystem()
-{
     OpenGL::render_begin();
-    program.free_resources();
+    for (int i = 0; i < num_particles && spawned < num; i++)
+    {
+        if (death_update[i] > update_count)
+        {
+            continue;
+        }
+
+        if (!run.empty() && (run_start + (int)run.size() != i))
+        {
+            gpu->set_particles(run_start, run);
+            run.clear();
+        }
+
+        if (run.empty())
+        {
+            run_start = i;
+        }
+
+        Particle p;
+        pinit_func(p);
+        run.push_back(p);
+
+        death_update[i] = update_count + updates_to_live(p);
+        live_range = std::max(live_range, i + 1);
+        ++spawned;
+        ++particles_alive;
+    }
+
+    if (!run.empty())
+    {
+        gpu->set_particles(run_start, run);
+    }
+
     OpenGL::render_end();
+
+    return spawned;
 }
 
 int ParticleSystem::spawn(int num)
 {
-    // TODO: multithread this
+    if (gpu)
+    {
+        return spawn_gpu(num);
+    }
+
+    /* The initer usually uses std::rand(), which is not thread-safe, so
+     * spawning happens on the main thread. It touches only the spawned
+     * particles, so it is cheap compared to update(). */
     int spawned = 0;
-    for (size_t i = 0; i < ps.size() && spawned < num; i++)
+    for (int i = 0; i < num_particles && spawned < num; i++)
     {
-        if (ps[i].life <= 0)
+        if (life[i] <= 0)
         {
-            pinit_func(ps[i]);
+            Particle p;
+            pinit_func(p);
+            set_particle(i, p);
+
             ++spawned;
             ++particles_alive;
         }
@@ -76,86 +139,114 @@ int ParticleSystem::spawn(int num)
 
 void ParticleSystem::resize(int num)
 {
-    if (num == (int)ps.size())
+    if (num == num_particles)
     {
         return;
     }
 
-    // TODO: multithread this
-    for (int i = num; i < (int)ps.size(); i++)
+    if (gpu)
     {
-        if (ps[i].life >= 0)
+        if (num < num_particles)
         {
-            --particles_alive;
+            particles_alive -= std::count_if(death_update.begin() + num,
+                death_update.end(), [=] (uint64_t d) { return d > update_count; });
         }
+
+        num_particles = num;
+        death_update.resize(num, 0);
+        live_range = std::min(live_range, num);
+
+        OpenGL::render_begin();
+        gpu->resize(num);
+        OpenGL::render_end();
+
+        return;
     }
 
-    ps.resize(num);
+    if (num < num_particles)
+    {
+        particles_alive -= std::count_if(life.begin() + num, life.end(),
+            [] (float l) { return l > 0; });
+    }
+
+    num_particles = num;
+    life.resize(num, -1);
+    fade.resize(num);
+    base_radius.resize(num);
+    speed_x.resize(num);
+    speed_y.resize(num);
+    g_x.resize(num);
+    g_y.resize(num);
+    start_x.resize(num);
 
     color.resize(color_per_particle * num);
-    dark_color.resize(color_per_particle * num);
     radius.resize(radius_per_particle * num);
     center.resize(center_per_particle * num);
 }
 
 int ParticleSystem::size()
 {
-    return ps.size();
+    return num_particles;
 }
 
 void ParticleSystem::update_worker(float time, int start, int end)
 {
-    end = std::min(end, (int)ps.size());
+    const float slowdown = 0.8;
+
+    /* The loop body has no branches, so that the compiler can vectorize it.
+     * Dead particles go through the same computations, but their state
+     * stays unchanged. */
+    int died = 0;
     for (int i = start; i < end; ++i)
     {
-        if (ps[i].life <= 0)
-        {
-            continue;
-        }
-
-        // printf("%d\n", i);
-        ps[i].update(time);
-
-        if (ps[i].life <= 0)
-        {
-            --particles_alive;
-        }
-
-        for (int j = 0; j < 4; j++) // maybe use memcpy?
-        {
-            color[4 * i + j] = ps[i].color[j];
-            dark_color[4 * i + j] = ps[i].color[j] * 0.5;
-        }
-
-        // printf("center %d gets %f", 2 * i, ps[i].pos[0]);
-        center[2 * i]     = ps[i].pos[0];
-        center[2 * i + 1] = ps[i].pos[1];
-
-        radius[i] = ps[i].radius;
+        const bool alive     = life[i] > 0;
+        const float old_life = life[i];
+        const float new_life =
+            alive ? old_life - fade[i] * 0.3f * slowdown : old_life;
+
+        const float pos_step = alive ? 0.2f * slowdown : 0.0f;
+        const float g_step   = alive ? 0.3f * slowdown : 0.0f;
+
+        float x = center[2 * i] + speed_x[i] * pos_step;
+        float y = center[2 * i + 1] + speed_y[i] * pos_step;
+        speed_x[i] += g_x[i] * g_step;
+        speed_y[i] += g_y[i] * g_step;
+
+        radius[i] = alive ?
+            base_radius[i] * std::sqrt(std::max(new_life, 0.0f)) : radius[i];
+        color[4 * i + 3] = alive ?
+            color[4 * i + 3] / old_life * new_life : color[4 * i + 3];
+        g_x[i] = alive ? (start_x[i] < x ? -1.0f : 1.0f) : g_x[i];
+
+        /* move particles which just died outside */
+        const bool just_died = alive && (new_life <= 0);
+        center[2 * i]     = just_died ? -10000.0f : x;
+        center[2 * i + 1] = just_died ? -10000.0f : y;
+        died += just_died;
+
+        life[i] = new_life;
     }
+
+    particles_alive -= died;
 }
 
-void ParticleSystem::exec_worker_threads(std::function<void(int, int)> spawn_worker)
+void ParticleSystem::update_gpu()
 {
-// return spawn_worker(0, ps.size());
+    OpenGL::render_begin();
+    gpu->update(live_range);
+    OpenGL::render_end();
 
-    const int num_threads = std::thread::hardware_concurrency();
-    const int worker_load = (ps.size() + num_threads - 1) / num_threads;
+    ++update_count;
 
-    std::thread workers[num_threads];
-    for (int i = 0; i < num_threads; i++)
+    /* Particles past the last live one don't need to be simulated or drawn */
+    while (live_range > 0 && death_update[live_range - 1] <= update_count)
     {
-        int thread_start = i * worker_load;
-        int thread_end   = (i + 1) * worker_load;
-        thread_end = std::min(thread_end, (int)ps.size());
-
-        workers[i] = std::thread([=] () { spawn_worker(thread_start, thread_end); });
+        --live_range;
     }
 
-    for (auto& w : workers)
-    {
-        w.join();
-    }
+    particles_alive = std::count_if(death_update.begin(),
+        death_update.begin() + live_range,
+        [=] (uint64_t d) { return d > update_count; });
 }
 
 void ParticleSystem::update()
@@ -164,7 +255,16 @@ void ParticleSystem::update()
     float time = (wf::get_current_time() - last_update_msec) / 16.0;
     last_update_msec = wf::get_current_time();
 
-    exec_worker_threads([=] (int start, int end)
+    if (gpu)
+    {
+        update_gpu();
+        return;
+    }
+
+    /* Large enough chunks, so that synchronization doesn't dominate */
+    static constexpr int particles_per_task = 1024;
+    wf::get_core().get_thread_pool().parallel_for(0, num_particles,
+        particles_per_task, [=] (int start, int end)
     {
         update_worker(time, start, end);
     });
@@ -181,6 +281,7 @@ void ParticleSystem::create_program()
     OpenGL::render_begin();
     program.set_simple(OpenGL::compile_program(particle_vert_source,
         particle_frag_source));
+    gpu = ParticleSystemGPU::create();
     OpenGL::render_end();
 }
 
@@ -197,31 +298,39 @@ void ParticleSystem::render(glm::mat4 matrix)
     program.attrib_pointer("position", 2, 0, vertex_data);
     program.attrib_divisor("position", 0);
 
-    program.attrib_pointer("radius", 1, 0, radius.data());
-    program.attrib_divisor("radius", 1);
+    int instances = num_particles;
+    if (gpu)
+    {
+        gpu->bind_render_attributes(program);
+        instances = live_range;
+    } else
+    {
+        program.attrib_pointer("radius", 1, 0, radius.data());
+        program.attrib_pointer("center", 2, 0, center.data());
+        program.attrib_pointer("color", 4, 0, color.data());
+    }
 
-    program.attrib_pointer("center", 2, 0, center.data());
+    program.attrib_divisor("radius", 1);
     program.attrib_divisor("center", 1);
+    program.attrib_divisor("color", 1);
 
     // matrix
     program.uniformMatrix4f("matrix", matrix);
 
     /* Darken the background */
-    program.attrib_pointer("color", 4, 0, dark_color.data());
-    program.attrib_divisor("color", 1);
-
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA));
     program.uniform1f("smoothing", 0.7);
+    program.uniform1f("color_scale", 0.5);
 
     // TODO: optimize shaders for this case
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, instances));
 
     // particle color
-    program.attrib_pointer("color", 4, 0, color.data());
     GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
     program.uniform1f("smoothing", 0.5);
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    program.uniform1f("color_scale", 1.0);
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, instances));
 
     GL_CALL(glDisable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
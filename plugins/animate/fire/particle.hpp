@@ -4,8 +4,10 @@
 #include <wayfire/opengl.hpp>
 #include <functional>
 #include <atomic>
+#include <memory>
 #include <vector>
 
+/* The initial state of a particle, filled in by ParticleIniter */
 struct Particle
 {
     float life = -1;
@@ -17,16 +19,13 @@ struct Particle
     glm::vec2 start_pos;
 
     glm::vec4 color{1.0, 1.0, 1.0, 1.0};
-
-    /* update the given particle
-     * time is the percentage of the frame which has elapsed
-     * must be thread-safe */
-    void update(float time);
 };
 
 /* a function to initialize a particle */
 using ParticleIniter = std::function<void (Particle&)>;
 
+class ParticleSystemGPU;
+
 class ParticleSystem
 {
   public:
@@ -65,10 +64,28 @@ class ParticleSystem
     uint32_t last_update_msec;
 
     std::atomic<int> particles_alive;
-    std::vector<Particle> ps;
+
+    int num_particles = 0;
+
+    /* If available, the particles are simulated on the GPU and the arrays
+     * below are unused. The CPU only keeps track of which particles are
+     * alive, which it can calculate from their initial life and fade. */
+    std::unique_ptr<ParticleSystemGPU> gpu;
+    uint64_t update_count = 0;
+    /* the value of update_count at which each particle dies */
+    std::vector<uint64_t> death_update;
+    /* all particles with index >= live_range are dead */
+    int live_range = 0;
+
+    /* The particle state is stored as a structure of arrays, so that the
+     * update can be vectorized. The position, radius and color of particles
+     * are stored directly in the arrays which are passed to the GPU. */
+    std::vector<float> life, fade, base_radius;
+    std::vector<float> speed_x, speed_y, g_x, g_y;
+    std::vector<float> start_x;
 
     static constexpr int color_per_particle = 4;
-    std::vector<float> color, dark_color;
+    std::vector<float> color;
 
     static constexpr int radius_per_particle = 1;
     std::vector<float> radius;
@@ -77,8 +94,11 @@ class ParticleSystem
     std::vector<float> center;
 
     OpenGL::program_t program;
-    void exec_worker_threads(std::function<void(int, int)> spawn_worker);
+    /* store the initial state of the i-th particle */
+    void set_particle(int i, const Particle& p);
     void update_worker(float time, int start, int end);
+    void update_gpu();
+    int spawn_gpu(int num);
     void create_program();
 };
 
@@ -11,6 +11,7 @@ attribute mediump vec2 center;
 attribute mediump vec4 color;
 
 uniform mat4 matrix;
+uniform mediump float color_scale;
 
 varying mediump vec2 uv;
 varying mediump vec4 out_color;
@@ -21,7 +22,7 @@ void main() {
     gl_Position = matrix * vec4(center.x + uv.x * 0.75, center.y + uv.y, 0.0, 1.0);
 
     R = radius;
-    out_color = color;
+    out_color = color * color_scale;
 }
 )";
 
@@ -50,4 +51,78 @@ void main()
 }
 )";
 
+/* Simulates one step of the particle update on the GPU, with the results
+ * captured by transform feedback. It has to match
+ * ParticleSystem::update_worker(), and the outputs have to be in the order
+ * of the fields in the GPU particle buffer. */
+static const char *particle_simulate_vert_source =
+    R"(
+#version 300 es
+
+in float life;
+in float fade;
+in float base_radius;
+in float radius;
+in vec2 pos;
+in vec2 speed;
+in vec2 g;
+in float start_x;
+in vec4 color;
+
+out float tf_life;
+out float tf_fade;
+out float tf_base_radius;
+out float tf_radius;
+out vec2 tf_pos;
+out vec2 tf_speed;
+out vec2 tf_g;
+out float tf_start_x;
+out vec4 tf_color;
+
+void main()
+{
+    const float slowdown = 0.8;
+
+    tf_fade = fade;
+    tf_base_radius = base_radius;
+    tf_start_x = start_x;
+
+    tf_life = life;
+    tf_radius = radius;
+    tf_pos = pos;
+    tf_speed = speed;
+    tf_g = g;
+    tf_color = color;
+
+    if (life > 0.0)
+    {
+        tf_life = life - fade * 0.3 * slowdown;
+        tf_pos = pos + speed * 0.2 * slowdown;
+        tf_speed = speed + g * 0.3 * slowdown;
+        tf_radius = base_radius * sqrt(max(tf_life, 0.0));
+        tf_color.a = color.a / life * tf_life;
+        tf_g.x = start_x < tf_pos.x ? -1.0 : 1.0;
+
+        if (tf_life <= 0.0)
+        {
+            /* move outside */
+            tf_pos = vec2(-10000.0, -10000.0);
+        }
+    }
+}
+)";
+
+static const char *particle_simulate_frag_source =
+    R"(
+#version 300 es
+precision mediump float;
+
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = vec4(0.0);
+}
+)";
+
 #endif /* end of include guard: PARTICLE_ANIMATION_SHADER */
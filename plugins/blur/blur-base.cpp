@@ -82,7 +82,27 @@ wf_blur_base::~wf_blur_base()
 
 int wf_blur_base::calculate_blur_radius()
 {
-    return offset_opt * degrade_opt * std::max(1, (int)iterations_opt);
+    return get_offset() * get_degrade() * std::max(1, (int)iterations_opt);
+}
+
+int wf_blur_base::get_degrade()
+{
+    return degrade_opt * (1 << quality_reduction);
+}
+
+float wf_blur_base::get_offset()
+{
+    return offset_opt / (1 << quality_reduction);
+}
+
+void wf_blur_base::set_quality_reduction(int level)
+{
+    this->quality_reduction = std::max(level, 0);
+}
+
+int wf_blur_base::get_quality_reduction()
+{
+    return quality_reduction;
 }
 
 void wf_blur_base::render_iteration(wf::region_t blur_region,
@@ -148,9 +168,10 @@ wlr_box wf_blur_base::copy_region(wf::framebuffer_base_t& result,
 
     // Make sure that the box is aligned properly for degrading, otherwise,
     // we get a flickering
-    subbox = sanitize(subbox, degrade_opt, source_box);
-    int degraded_width  = subbox.width / degrade_opt;
-    int degraded_height = subbox.height / degrade_opt;
+    int degrade = get_degrade();
+    subbox = sanitize(subbox, degrade, source_box);
+    int degraded_width  = subbox.width / degrade;
+    int degraded_height = subbox.height / degrade;
 
     OpenGL::render_begin(source);
     result.allocate(degraded_width, degraded_height);
@@ -168,9 +189,10 @@ wlr_box wf_blur_base::copy_region(wf::framebuffer_base_t& result,
 }
 
 void wf_blur_base::pre_render(wf::texture_t src_tex, wlr_box src_box,
-    const wf::region_t& damage, const wf::framebuffer_t& target_fb)
+    const wf::region_t& damage, const wf::framebuffer_t& target_fb,
+    wf::framebuffer_base_t& result)
 {
-    int degrade     = degrade_opt;
+    int degrade     = get_degrade();
     auto damage_box = copy_region(fb[0], target_fb, damage);
 
     /* As an optimization, we create a region that blur can use
@@ -189,8 +211,7 @@ void wf_blur_base::pre_render(wf::texture_t src_tex, wlr_box src_box,
 
     int r = blur_fb0(blur_damage, fb[0].viewport_width, fb[0].viewport_height);
 
-    /* Make sure the result is always fb[1], because that's what is used in render()
-     * */
+    /* Make sure the result is always fb[0] */
     if (r != 0)
     {
         std::swap(fb[0], fb[1]);
@@ -201,28 +222,39 @@ void wf_blur_base::pre_render(wf::texture_t src_tex, wlr_box src_box,
     auto view_box = target_fb.framebuffer_box_from_geometry_box(src_box);
 
     OpenGL::render_begin();
-    fb[1].allocate(view_box.width, view_box.height);
-    fb[1].bind();
+    result.allocate(view_box.width, view_box.height);
+    result.bind();
     GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, fb[0].fb));
 
     /* Blit the blurred texture into an fb which has the size of the view,
      * so that the view texture and the blurred background can be combined
-     * together in render()
+     * together in render(). The result may contain still valid parts of
+     * the blurred background from previous frames, so we copy only the
+     * damaged parts.
      *
      * local_geometry is damage_box relative to view box */
     wlr_box local_box = damage_box + wf::point_t{-view_box.x, -view_box.y};
-    GL_CALL(glBlitFramebuffer(0, 0, fb[0].viewport_width, fb[0].viewport_height,
-        local_box.x,
-        view_box.height - local_box.y - local_box.height,
-        local_box.x + local_box.width,
-        view_box.height - local_box.y,
-        GL_COLOR_BUFFER_BIT, GL_LINEAR));
+    for (const auto& rect : damage)
+    {
+        auto box = target_fb.framebuffer_box_from_geometry_box(
+            wlr_box_from_pixman_box(rect));
+        result.scissor(box + wf::point_t{-view_box.x, -view_box.y});
+
+        GL_CALL(glBlitFramebuffer(0, 0,
+            fb[0].viewport_width, fb[0].viewport_height,
+            local_box.x,
+            view_box.height - local_box.y - local_box.height,
+            local_box.x + local_box.width,
+            view_box.height - local_box.y,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR));
+    }
+
     GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
     OpenGL::render_end();
 }
 
 void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box,
-    wlr_box scissor_box, const wf::framebuffer_t& target_fb)
+    wlr_box scissor_box, const wf::framebuffer_t& target_fb, GLuint bg_tex)
 {
     wlr_box fb_geom =
         target_fb.framebuffer_box_from_geometry_box(target_fb.geometry);
@@ -249,7 +281,7 @@ void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box,
 
     blend_program.set_active_texture(src_tex);
     GL_CALL(glActiveTexture(GL_TEXTURE0 + 1));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, fb[1].tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, bg_tex));
     /* Render it to target_fb */
     target_fb.bind();
     GL_CALL(glViewport(view_box.x, fb_geom.height - view_box.y - view_box.height,
@@ -292,6 +324,11 @@ std::unique_ptr<wf_blur_base> create_blur_from_name(wf::output_t *output,
         return create_gaussian_blur(output);
     }
 
+    if (algorithm_name == "dual_kawase")
+    {
+        return create_dual_kawase_blur(output);
+    }
+
     LOGE("Unrecognized blur algorithm %s. Using default kawase blur.",
         algorithm_name.c_str());
 
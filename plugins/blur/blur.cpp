@@ -6,23 +6,130 @@
 #include <wayfire/workspace-stream.hpp>
 #include <wayfire/workspace-manager.hpp>
 #include <wayfire/signal-definitions.hpp>
+#include <wayfire/nonstd/reverse.hpp>
+#include <map>
 
 #include "blur.hpp"
 
 using blur_algorithm_provider = std::function<nonstd::observer_ptr<wf_blur_base>()>;
+
+/** Expand each rectangle of the region by padding pixels in each direction */
+static wf::region_t pad_region(const wf::region_t& region, int padding)
+{
+    wf::region_t padded;
+    for (const auto& rect : region)
+    {
+        padded |= wlr_box{
+            (rect.x1 - padding),
+            (rect.y1 - padding),
+            (rect.x2 - rect.x1) + 2 * padding,
+            (rect.y2 - rect.y1) + 2 * padding
+        };
+    }
+
+    return padded;
+}
+
+/** Get the part of the region which is at least padding pixels away from its
+ * boundary */
+static wf::region_t shrink_region(const wf::region_t& region, int padding)
+{
+    auto extents = wlr_box_from_pixman_box(region.get_extents());
+    wf::region_t outside = pad_region(extents, padding + 1) ^ region;
+
+    return region ^ pad_region(outside, padding);
+}
+
+/** The damage of the workspace stream which is currently being repainted */
+struct blur_stream_damage_t
+{
+    /* The whole repainted region, including padding */
+    wf::region_t damage;
+    /* The geometry of the stream framebuffer */
+    wf::geometry_t fb_geometry;
+};
+
 class wf_blur_transformer : public wf::view_transformer_t
 {
     blur_algorithm_provider provider;
     wf::output_t *output;
     wayfire_view view;
+    const blur_stream_damage_t *stream_damage;
+
+    /* The blurred background from previous frames, with the size of the view
+     * box in framebuffer coordinates */
+    wf::framebuffer_base_t cache;
+    /* The part of the cache which is still up-to-date */
+    wf::region_t cache_valid;
+
+    /* The cache is valid only as long as the view is rendered to the same
+     * place and with the same framebuffer parameters */
+    struct cache_key_t
+    {
+        wf::geometry_t fb_geometry;
+        float fb_scale;
+        uint32_t fb_transform;
+        wlr_box src_box;
+
+        bool operator ==(const cache_key_t& other) const
+        {
+            return fb_geometry == other.fb_geometry &&
+                   fb_scale == other.fb_scale &&
+                   fb_transform == other.fb_transform &&
+                   src_box == other.src_box;
+        }
+    } cache_key;
+
+    cache_key_t get_cache_key(const wf::framebuffer_t& fb, wlr_box src_box)
+    {
+        return {fb.geometry, fb.scale, fb.wl_transform, src_box};
+    }
 
   public:
     wf_blur_transformer(blur_algorithm_provider blur_algorithm_provider,
-        wf::output_t *output, wayfire_view view)
+        wf::output_t *output, wayfire_view view,
+        const blur_stream_damage_t *stream_damage)
     {
         provider     = blur_algorithm_provider;
         this->output = output;
         this->view   = view;
+        this->stream_damage = stream_damage;
+    }
+
+    ~wf_blur_transformer()
+    {
+        OpenGL::render_begin();
+        cache.release();
+        OpenGL::render_end();
+    }
+
+    /**
+     * Mark the given region of the cached blurred background as outdated,
+     * because the background in it has changed.
+     */
+    void invalidate_cache(const wf::region_t& region)
+    {
+        cache_valid ^= region;
+    }
+
+    void invalidate_cache()
+    {
+        cache_valid.clear();
+    }
+
+    /**
+     * Get the region in which the view can reuse its blurred background,
+     * when rendered to a framebuffer like fb.
+     */
+    wf::region_t get_cached_region(const wf::framebuffer_t& fb)
+    {
+        if (view->sticky ||
+            !(get_cache_key(fb, view->get_bounding_box()) == cache_key))
+        {
+            return {};
+        }
+
+        return cache_valid;
     }
 
     wf::pointf_t transform_point(wf::geometry_t view,
@@ -95,10 +202,33 @@ class wf_blur_transformer : public wf::view_transformer_t
             return;
         }
 
+        auto key = get_cache_key(target_fb, src_box);
+        if (view->sticky || !(key == cache_key))
+        {
+            cache_valid.clear();
+            cache_key = key;
+        }
+
         wf::region_t opaque_region  = view->get_transformed_opaque_region();
         wf::region_t blurred_region = clip_damage ^ opaque_region;
 
-        provider()->pre_render(src_tex, src_box, blurred_region, target_fb);
+        /* Blur only the parts whose background changed since they were last
+         * blurred, the rest can be reused from the cache. */
+        wf::region_t outdated_region = blurred_region ^ cache_valid;
+        if (!outdated_region.empty())
+        {
+            provider()->pre_render(src_tex, src_box, outdated_region,
+                target_fb, cache);
+
+            /* Near the edges of the repainted region, the blur samples pixels
+             * from the last frame, so the result there is not reusable. */
+            if (!view->sticky && (target_fb.geometry == stream_damage->fb_geometry))
+            {
+                cache_valid |=
+                    shrink_region(stream_damage->damage, padding) & outdated_region;
+            }
+        }
+
         wf::view_transformer_t::render_with_damage(src_tex, src_box, blurred_region,
             target_fb);
 
@@ -109,8 +239,97 @@ class wf_blur_transformer : public wf::view_transformer_t
     void render_box(wf::texture_t src_tex, wlr_box src_box, wlr_box scissor_box,
         const wf::framebuffer_t& target_fb) override
     {
-        provider()->render(src_tex, src_box, scissor_box, target_fb);
+        provider()->render(src_tex, src_box, scissor_box, target_fb, cache.tex);
+    }
+};
+
+/**
+ * Decides how much the blur quality should be reduced, based on the timing of
+ * the last frames of the output.
+ *
+ * The quality is reduced by one level after a few consecutive frames which
+ * missed the refresh deadline or came close to it. It is restored by one level
+ * after many consecutive frames which were rendered well within the deadline,
+ * and fully as soon as the output goes idle. If the quality has to be reduced
+ * again shortly after restoring it, the number of frames needed for the next
+ * restore is doubled, so that the quality does not flicker between levels.
+ */
+class blur_quality_controller_t
+{
+  public:
+    static constexpr int MAX_REDUCTION = 2;
+
+    /**
+     * @param timing The timing of the last frame.
+     * @return The quality reduction level which should be used next.
+     */
+    int update(const wf::frame_timing_t& timing)
+    {
+        if (timing.refresh_interval <= 0)
+        {
+            if (timing.frame_interval < 0)
+            {
+                reset();
+            }
+
+            return level;
+        }
+
+        /* Only frames which follow another frame closely can be late. Frames
+         * painted after the output was idle are judged by their render time. */
+        const bool continuous = timing.frame_interval >= 0;
+        const bool missed     =
+            (timing.render_time > timing.refresh_interval * 0.8) ||
+            (continuous && (timing.frame_interval > timing.refresh_interval * 1.5));
+        if (!continuous && !missed)
+        {
+            /* Output was idle, so there is no animation going on */
+            reset();
+            return level;
+        }
+
+        const bool fast = timing.render_time < timing.refresh_interval * 0.4;
+
+        slow_frames = missed ? slow_frames + 1 : 0;
+        fast_frames = fast ? fast_frames + 1 : 0;
+
+        if ((slow_frames >= MIN_SLOW_FRAMES) && (level < MAX_REDUCTION))
+        {
+            ++level;
+            if (frames_since_restore < restore_frames)
+            {
+                restore_frames = std::min(restore_frames * 2, MAX_RESTORE_FRAMES);
+            }
+
+            slow_frames = fast_frames = 0;
+        } else if ((fast_frames >= restore_frames) && (level > 0))
+        {
+            --level;
+            frames_since_restore = 0;
+            slow_frames = fast_frames = 0;
+        }
+
+        ++frames_since_restore;
+        return level;
+    }
+
+    void reset()
+    {
+        level = 0;
+        slow_frames = fast_frames = 0;
+        restore_frames = MIN_RESTORE_FRAMES;
     }
+
+  private:
+    static constexpr int MIN_SLOW_FRAMES    = 3;
+    static constexpr int MIN_RESTORE_FRAMES = 60;
+    static constexpr int MAX_RESTORE_FRAMES = 960;
+
+    int level = 0;
+    int slow_frames = 0;
+    int fast_frames = 0;
+    int restore_frames = MIN_RESTORE_FRAMES;
+    int frames_since_restore = MAX_RESTORE_FRAMES;
 };
 
 class wayfire_blur : public wf::plugin_interface_t
@@ -119,11 +338,13 @@ class wayfire_blur : public wf::plugin_interface_t
 
     wf::effect_hook_t frame_pre_paint;
     wf::signal_callback_t workspace_stream_pre, workspace_stream_post,
-        view_attached, view_detached;
+        view_attached, view_detached, view_damaged, stack_order_changed;
 
     wf::view_matcher_t blur_by_default{"blur/blur_by_default"};
     wf::option_wrapper_t<std::string> method_opt{"blur/method"};
     wf::option_wrapper_t<wf::buttonbinding_t> toggle_button{"blur/toggle"};
+    wf::option_wrapper_t<bool> adaptive_quality{"blur/adaptive_quality"};
+    blur_quality_controller_t quality_controller;
     wf::config::option_base_t::updated_callback_t blur_method_changed;
     std::unique_ptr<wf_blur_base> blur_algorithm;
 
@@ -133,6 +354,17 @@ class wayfire_blur : public wf::plugin_interface_t
     wf::framebuffer_base_t saved_pixels;
     wf::region_t padded_region;
 
+    /* the damage of the workspace stream being repainted, for transformers */
+    blur_stream_damage_t stream_damage;
+
+    /* damage reported by each view since the last frame, used to find out
+     * which damage is below a blurred view */
+    std::map<wf::view_interface_t*, wf::region_t> view_damage;
+
+    /* whether the stacking order changed since the last frame, in which case
+     * view_damage may have been reported at a view's old stacking position */
+    bool stack_order_dirty = false;
+
     void add_transformer(wayfire_view view)
     {
         if (view->get_transformer(transformer_name))
@@ -142,10 +374,16 @@ class wayfire_blur : public wf::plugin_interface_t
 
         view->add_transformer(std::make_unique<wf_blur_transformer>(
             [=] () {return nonstd::make_observer(blur_algorithm.get()); },
-            output, view),
+            output, view, &stream_damage),
             transformer_name);
     }
 
+    nonstd::observer_ptr<wf_blur_transformer> get_transformer(wayfire_view view)
+    {
+        return nonstd::make_observer(dynamic_cast<wf_blur_transformer*>(
+            view->get_transformer(transformer_name).get()));
+    }
+
     void pop_transformer(wayfire_view view)
     {
         if (view->get_transformer(transformer_name))
@@ -184,23 +422,34 @@ class wayfire_blur : public wf::plugin_interface_t
         int padding = std::ceil(
             blur_algorithm->calculate_blur_radius() / scale);
 
-        wf::region_t padded;
-        for (const auto& rect : region)
-        {
-            padded |= wlr_box{
-                (rect.x1 - padding),
-                (rect.y1 - padding),
-                (rect.x2 - rect.x1) + 2 * padding,
-                (rect.y2 - rect.y1) + 2 * padding
-            };
-        }
-
-        return padded;
+        return pad_region(region, padding);
     }
 
     // Blur region for current frame
     wf::region_t blur_region;
 
+    /** Get the region which the given blurred view covers on all workspaces */
+    wf::region_t get_view_blur_region(wayfire_view view)
+    {
+        auto bbox = view->get_bounding_box();
+        if (!view->sticky)
+        {
+            return bbox;
+        }
+
+        wf::region_t region;
+        auto wsize = output->workspace->get_workspace_grid_size();
+        for (int i = 0; i < wsize.width; i++)
+        {
+            for (int j = 0; j < wsize.height; j++)
+            {
+                region |= bbox + wf::origin(output->render->get_ws_box({i, j}));
+            }
+        }
+
+        return region;
+    }
+
     void update_blur_region()
     {
         blur_region.clear();
@@ -213,23 +462,123 @@ class wayfire_blur : public wf::plugin_interface_t
                 continue;
             }
 
-            auto bbox = view->get_bounding_box();
-            if (!view->sticky)
+            blur_region |= get_view_blur_region(view);
+        }
+    }
+
+    /**
+     * Get the part of damage in which blurred views cannot reuse their cached
+     * blurred background, when rendered to a framebuffer like fb.
+     */
+    wf::region_t get_uncached_region(const wf::region_t& damage,
+        const wf::framebuffer_t& fb)
+    {
+        wf::region_t uncached;
+        for (auto& view : output->workspace->get_views_in_layer(wf::ALL_LAYERS))
+        {
+            auto tr = get_transformer(view);
+            if (tr)
             {
-                blur_region |= bbox;
-            } else
+                uncached |= (damage & get_view_blur_region(view)) ^
+                    tr->get_cached_region(fb);
+            }
+        }
+
+        return uncached;
+    }
+
+    /**
+     * Invalidate the cached blurred background of each view in the parts which
+     * are affected by damage below the view in the stacking order.
+     *
+     * @return The region of the views whose blurred background changed.
+     */
+    wf::region_t invalidate_blur_caches(const wf::region_t& damage, int padding)
+    {
+        /* All views from the bottom to the top of the stack */
+        std::vector<wayfire_view> views;
+        auto toplevels = output->workspace->get_views_in_layer(wf::ALL_LAYERS);
+        for (auto& toplevel : wf::reverse(toplevels))
+        {
+            for (auto& view : wf::reverse(toplevel->enumerate_views(false)))
             {
-                auto wsize = output->workspace->get_workspace_grid_size();
-                for (int i = 0; i < wsize.width; i++)
+                views.push_back(view);
+            }
+        }
+
+        /* Damage which doesn't come from a view in the stack, for ex. when a
+         * plugin damages the whole output or when a view was unmapped or moved
+         * to another output, is treated as if it were below all views. If the
+         * stacking order changed, views may have damaged their old position,
+         * so all damage is treated as below all views. */
+        wf::region_t damage_below = damage;
+        if (!stack_order_dirty)
+        {
+            for (auto& view : views)
+            {
+                auto it = view_damage.find(view.get());
+                if (it != view_damage.end())
                 {
-                    for (int j = 0; j < wsize.height; j++)
-                    {
-                        blur_region |=
-                            bbox + wf::origin(output->render->get_ws_box({i, j}));
-                    }
+                    damage_below ^= it->second;
                 }
             }
         }
+
+        wf::region_t invalidated;
+        for (auto& view : views)
+        {
+            auto tr = get_transformer(view);
+            if (tr)
+            {
+                auto bbox    = view->get_bounding_box();
+                auto changed = pad_region(
+                    damage_below & pad_region(bbox, padding), padding) & bbox;
+
+                tr->invalidate_cache(changed);
+                invalidated |= changed;
+            }
+
+            auto it = view_damage.find(view.get());
+            if (it != view_damage.end())
+            {
+                damage_below |= it->second;
+            }
+        }
+
+        return invalidated;
+    }
+
+    void invalidate_all_caches()
+    {
+        for (auto& view : output->workspace->get_views_in_layer(wf::ALL_LAYERS))
+        {
+            if (auto tr = get_transformer(view))
+            {
+                tr->invalidate_cache();
+            }
+        }
+    }
+
+    /**
+     * Adjust the quality of the blur algorithm to the time the last frames
+     * took to render.
+     */
+    void update_blur_quality()
+    {
+        int level = 0;
+        if (adaptive_quality)
+        {
+            level = quality_controller.update(output->render->get_frame_timing());
+        }
+
+        if (level != blur_algorithm->get_quality_reduction())
+        {
+            blur_algorithm->set_quality_reduction(level);
+            /* The cached backgrounds have a different quality, so they
+             * would be visible as seams if some parts are repainted */
+            invalidate_all_caches();
+            output->render->damage_whole();
+        }
     }
 
     /** Find the region of blurred views on the given workspace */
@@ -247,6 +596,8 @@ class wayfire_blur : public wf::plugin_interface_t
         blur_method_changed = [=] ()
         {
             blur_algorithm = create_blur_from_name(output, method_opt);
+            quality_controller.reset();
+            invalidate_all_caches();
             output->render->damage_whole();
         };
         /* Create initial blur algorithm */
@@ -307,13 +658,31 @@ class wayfire_blur : public wf::plugin_interface_t
         output->connect_signal("view-mapped", &view_attached);
         output->connect_signal("view-detached", &view_detached);
 
+        view_damaged = [=] (wf::signal_data_t *data)
+        {
+            auto ev = static_cast<wf::view_region_damaged_signal*>(data);
+            view_damage[ev->view.get()] |= ev->box;
+        };
+        output->connect_signal("view-region-damaged", &view_damaged);
+
+        stack_order_changed = [=] (wf::signal_data_t*)
+        {
+            stack_order_dirty = true;
+        };
+        output->connect_signal("stack-order-changed", &stack_order_changed);
+
         /* frame_pre_paint is called before each frame has started.
          * It expands the damage by the blur radius.
          * This is needed, because when blurring, the pixels that changed
          * affect a larger area than the really damaged region, e.g the region
-         * that comes from client damage */
+         * that comes from client damage.
+         *
+         * Blurred views keep their blurred background between frames, so
+         * damage expansion is needed only where the background below them
+         * has changed. */
         frame_pre_paint = [=] ()
         {
+            update_blur_quality();
             update_blur_region();
             auto damage    = output->render->get_scheduled_damage();
             const auto& fb = output->render->get_target_framebuffer();
@@ -323,8 +692,13 @@ class wayfire_blur : public wf::plugin_interface_t
             wf::surface_interface_t::set_opaque_shrink_constraint("blur",
                 padding);
 
+            damage |= invalidate_blur_caches(damage, padding);
+            view_damage.clear();
+            stack_order_dirty = false;
+
+            output->render->damage(damage);
             output->render->damage(expand_region(
-                damage & this->blur_region, fb.scale));
+                get_uncached_region(damage & this->blur_region, fb), fb.scale));
         };
         output->render->add_effect(&frame_pre_paint, wf::OUTPUT_EFFECT_DAMAGE);
 
@@ -340,8 +714,9 @@ class wayfire_blur : public wf::plugin_interface_t
             const auto& ws = static_cast<wf::stream_signal_t*>(data)->ws;
             const auto& target_fb = static_cast<wf::stream_signal_t*>(data)->fb;
 
-            wf::region_t expanded_damage =
-                expand_region(damage & get_blur_region(ws), target_fb.scale);
+            wf::region_t expanded_damage = expand_region(
+                get_uncached_region(damage & get_blur_region(ws), target_fb),
+                target_fb.scale);
 
             /* Keep rects on screen */
             expanded_damage &= output->render->get_ws_box(ws);
@@ -375,6 +750,8 @@ class wayfire_blur : public wf::plugin_interface_t
 
             /* This effectively makes damage the same as expanded_damage. */
             damage |= expanded_damage;
+            stream_damage.damage = damage;
+            stream_damage.fb_geometry = target_fb.geometry;
             GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
             OpenGL::render_end();
         };
@@ -432,6 +809,8 @@ class wayfire_blur : public wf::plugin_interface_t
         output->disconnect_signal("view-attached", &view_attached);
         output->disconnect_signal("view-mapped", &view_attached);
         output->disconnect_signal("view-detached", &view_detached);
+        output->disconnect_signal("view-region-damaged", &view_damaged);
+        output->disconnect_signal("stack-order-changed", &stack_order_changed);
         output->render->rem_effect(&frame_pre_paint);
         output->render->disconnect_signal("workspace-stream-pre",
             &workspace_stream_pre);
@@ -108,6 +108,16 @@ class wf_blur_base
 
     wf::output_t *output;
 
+    /* how many times the degrade has been doubled to save rendering time,
+     * see set_quality_reduction() */
+    int quality_reduction = 0;
+
+    /* the degrade and offset which should be used for rendering. They are
+     * the configured values, adjusted for the current quality reduction,
+     * so that the blur radius stays approximately the same */
+    int get_degrade();
+    float get_offset();
+
     /* renders the in texture to the out framebuffer.
      * assumes a properly bound and initialized GL program */
     void render_iteration(wf::region_t blur_region,
@@ -130,17 +140,30 @@ class wf_blur_base
 
     virtual int calculate_blur_radius();
 
+    /* render at a lower resolution to save time: the degrade is multiplied by
+     * 2^level, and the offset is divided by the same amount.
+     * level 0 is the configured quality. */
+    void set_quality_reduction(int level);
+    int get_quality_reduction();
+
+    /* blur the damaged region of target_fb and store it in result, which is
+     * resized to the size of src_box. Only the parts of result which are
+     * inside damage are overwritten. */
     virtual void pre_render(wf::texture_t src_tex, wlr_box src_box,
-        const wf::region_t& damage, const wf::framebuffer_t& target_fb);
+        const wf::region_t& damage, const wf::framebuffer_t& target_fb,
+        wf::framebuffer_base_t& result);
 
+    /* blend src_tex with the blurred background bg_tex, as created by
+     * pre_render() */
     virtual void render(wf::texture_t src_tex, wlr_box src_box,
-        wlr_box scissor_box, const wf::framebuffer_t& target_fb);
+        wlr_box scissor_box, const wf::framebuffer_t& target_fb, GLuint bg_tex);
 };
 
 std::unique_ptr<wf_blur_base> create_box_blur(wf::output_t *output);
 std::unique_ptr<wf_blur_base> create_bokeh_blur(wf::output_t *output);
 std::unique_ptr<wf_blur_base> create_kawase_blur(wf::output_t *output);
 std::unique_ptr<wf_blur_base> create_gaussian_blur(wf::output_t *output);
+std::unique_ptr<wf_blur_base> create_dual_kawase_blur(wf::output_t *output);
 
 std::unique_ptr<wf_blur_base> create_blur_from_name(wf::output_t *output,
     std::string algorithm_name);
@@ -68,7 +68,7 @@ class wf_bokeh_blur : public wf_blur_base
     int blur_fb0(const wf::region_t& blur_region, int width, int height) override
     {
         int iterations = iterations_opt;
-        float offset   = offset_opt;
+        float offset   = get_offset();
 
         static const float vertexData[] = {
             -1.0f, -1.0f,
@@ -101,7 +101,7 @@ class wf_bokeh_blur : public wf_blur_base
 
     int calculate_blur_radius() override
     {
-        return 5 * wf_blur_base::offset_opt*wf_blur_base::degrade_opt;
+        return 5 * get_offset() * get_degrade();
     }
 };
 
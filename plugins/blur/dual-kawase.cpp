@@ -0,0 +1,168 @@
+#include "blur.hpp"
+#include "kawase-shaders.hpp"
+
+/*
+ * Dual-Kawase blur (also known as dual filtering).
+ *
+ * The source image is downsampled to a pyramid of images, each with half the
+ * resolution of the previous one, and then upsampled back through the same
+ * levels. Each pass samples only a few texels, but because the sampling
+ * offsets grow together with the texel size, the blur radius grows
+ * exponentially with the number of iterations, while the cost of each
+ * additional level is only a quarter of the previous one.
+ */
+
+class wf_dual_kawase_blur : public wf_blur_base
+{
+    /* The downsampled levels of the pyramid. levels[i] has 1 / 2^(i+1) of the
+     * resolution of fb[0]. They are kept between frames, so that they have to
+     * be reallocated only when the size of the blurred area changes. There may
+     * be more levels than are used for the current blur. */
+    std::vector<wf::framebuffer_base_t> levels;
+
+    /* Get the number of downsampling steps, limited so that the smallest
+     * level is at least one pixel big */
+    int get_level_count(int width, int height)
+    {
+        int count = std::max(0, (int)iterations_opt);
+        while (count > 0 && ((width >> count) < 1 || (height >> count) < 1))
+        {
+            --count;
+        }
+
+        return count;
+    }
+
+    void set_halfpixel(OpenGL::program_t& prog,
+        const wf::framebuffer_base_t& source)
+    {
+        prog.uniform2f("halfpixel",
+            0.5f / source.viewport_width, 0.5f / source.viewport_height);
+    }
+
+  public:
+    wf_dual_kawase_blur(wf::output_t *output) :
+        wf_blur_base(output, "dual_kawase")
+    {
+        OpenGL::render_begin();
+        program[0].set_simple(OpenGL::compile_program(kawase_vertex_shader,
+            kawase_fragment_shader_down));
+        program[1].set_simple(OpenGL::compile_program(kawase_vertex_shader,
+            kawase_fragment_shader_up));
+        OpenGL::render_end();
+    }
+
+    ~wf_dual_kawase_blur()
+    {
+        OpenGL::render_begin();
+        for (auto& level : levels)
+        {
+            level.release();
+        }
+
+        OpenGL::render_end();
+    }
+
+    int blur_fb0(const wf::region_t& blur_region, int width, int height) override
+    {
+        int count = get_level_count(width, height);
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        /* Only the first count levels are used. The vector is never shrunk,
+         * because framebuffer_base_t doesn't release its resources when
+         * destroyed, so dropped levels would leak. */
+        if ((int)levels.size() < count)
+        {
+            levels.resize(count);
+        }
+
+        float offset = get_offset();
+
+        /* Upload data to shader */
+        static const float vertexData[] = {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            1.0f, 1.0f,
+            -1.0f, 1.0f
+        };
+
+        OpenGL::render_begin();
+        /* Disable blending, because we may have transparent background, which
+         * we want to render on uncleared framebuffer */
+        GL_CALL(glDisable(GL_BLEND));
+
+        /* Downsample fb[0] -> levels[0] -> ... -> levels[count - 1].
+         * The lower levels are small, so they are always rendered whole, which
+         * avoids sampling stale pixels around the damaged region. */
+        program[0].use(wf::TEXTURE_TYPE_RGBA);
+        program[0].attrib_pointer("position", 2, 0, vertexData);
+        program[0].uniform1f("offset", offset);
+        for (int i = 0; i < count; i++)
+        {
+            auto& source = (i == 0) ? fb[0] : levels[i - 1];
+            wlr_box level_box = {0, 0, width >> (i + 1), height >> (i + 1)};
+
+            set_halfpixel(program[0], source);
+            render_iteration(level_box, source, levels[i],
+                level_box.width, level_box.height);
+        }
+
+        program[0].deactivate();
+
+        /* Upsample levels[count - 1] -> ... -> levels[0] -> fb[1]. Only the
+         * last pass, which has the full resolution, is clipped to the
+         * requested region. */
+        program[1].use(wf::TEXTURE_TYPE_RGBA);
+        program[1].attrib_pointer("position", 2, 0, vertexData);
+        program[1].uniform1f("offset", offset);
+        for (int i = count - 1; i >= 0; i--)
+        {
+            set_halfpixel(program[1], levels[i]);
+            if (i > 0)
+            {
+                wlr_box level_box = {0, 0, width >> i, height >> i};
+                render_iteration(level_box, levels[i], levels[i - 1],
+                    level_box.width, level_box.height);
+            } else
+            {
+                render_iteration(blur_region, levels[0], fb[1], width, height);
+            }
+        }
+
+        /* Reset gl state */
+        GL_CALL(glEnable(GL_BLEND));
+        GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+
+        program[1].deactivate();
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        OpenGL::render_end();
+
+        return 1;
+    }
+
+    int calculate_blur_radius() override
+    {
+        /* The downsampling pass into level i (1-based) samples up to
+         * offset / 2 + 1 texels of level i - 1 away, and the upsampling pass
+         * out of level i samples up to offset + 1 texels of level i away,
+         * counting the bilinear filter footprint. A texel of level i covers
+         * 2^i pixels of the degraded image. */
+        float offset = get_offset();
+        float radius = 0;
+        for (int i = 1; i <= iterations_opt; i++)
+        {
+            radius += (offset / 2 + 1) * (1 << (i - 1));
+            radius += (offset + 1) * (1 << i);
+        }
+
+        return std::ceil(radius * get_degrade());
+    }
+};
+
+std::unique_ptr<wf_blur_base> create_dual_kawase_blur(wf::output_t *output)
+{
+    return std::make_unique<wf_dual_kawase_blur>(output);
+}
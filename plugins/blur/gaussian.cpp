@@ -82,7 +82,7 @@ class wf_gaussian_blur : public wf_blur_base
 
     void upload_data(int i, int width, int height)
     {
-        float offset = offset_opt;
+        float offset = get_offset();
         static const float vertexData[] = {
             -1.0f, -1.0f,
             1.0f, -1.0f,
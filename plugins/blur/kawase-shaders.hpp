@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * The passes of the Kawase blur, shared by the kawase and dual-kawase methods.
+ * The down pass averages the center texel with its four diagonal neighbours,
+ * the up pass averages eight texels around the center.
+ */
+
+static const char *const kawase_vertex_shader =
+    R"(
+#version 100
+attribute mediump vec2 position;
+
+varying mediump vec2 uv;
+
+void main() {
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+    uv = (position.xy + vec2(1.0, 1.0)) / 2.0;
+})";
+
+static const char *const kawase_fragment_shader_down =
+    R"(
+#version 100
+precision mediump float;
+
+uniform float offset;
+uniform vec2 halfpixel;
+uniform sampler2D bg_texture;
+
+varying mediump vec2 uv;
+
+void main()
+{
+    vec4 sum = texture2D(bg_texture, uv) * 4.0;
+    sum += texture2D(bg_texture, uv - halfpixel.xy * offset);
+    sum += texture2D(bg_texture, uv + halfpixel.xy * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset);
+    sum += texture2D(bg_texture, uv - vec2(halfpixel.x, -halfpixel.y) * offset);
+    gl_FragColor = sum / 8.0;
+})";
+
+static const char *const kawase_fragment_shader_up =
+    R"(
+#version 100
+precision mediump float;
+
+uniform float offset;
+uniform vec2 halfpixel;
+uniform sampler2D bg_texture;
+
+varying mediump vec2 uv;
+
+void main()
+{
+    vec4 sum = texture2D(bg_texture, uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(0.0, halfpixel.y * 2.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x * 2.0, 0.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(0.0, -halfpixel.y * 2.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    gl_FragColor = sum / 12.0;
+})";
@@ -1,61 +1,5 @@
 #include "blur.hpp"
-
-static const char *kawase_vertex_shader =
-    R"(
-#version 100
-attribute mediump vec2 position;
-
-varying mediump vec2 uv;
-
-void main() {
-    gl_Position = vec4(position.xy, 0.0, 1.0);
-    uv = (position.xy + vec2(1.0, 1.0)) / 2.0;
-})";
-
-static const char *kawase_fragment_shader_down =
-    R"(
-#version 100
-precision mediump float;
-
-uniform float offset;
-uniform vec2 halfpixel;
-uniform sampler2D bg_texture;
-
-varying mediump vec2 uv;
-
-void main()
-{
-    vec4 sum = texture2D(bg_texture, uv) * 4.0;
-    sum += texture2D(bg_texture, uv - halfpixel.xy * offset);
-    sum += texture2D(bg_texture, uv + halfpixel.xy * offset);
-    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset);
-    sum += texture2D(bg_texture, uv - vec2(halfpixel.x, -halfpixel.y) * offset);
-    gl_FragColor = sum / 8.0;
-})";
-
-static const char *kawase_fragment_shader_up =
-    R"(
-#version 100
-precision mediump float;
-
-uniform float offset;
-uniform vec2 halfpixel;
-uniform sampler2D bg_texture;
-
-varying mediump vec2 uv;
-
-void main()
-{
-    vec4 sum = texture2D(bg_texture, uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);
-    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;
-    sum += texture2D(bg_texture, uv + vec2(0.0, halfpixel.y * 2.0) * offset);
-    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;
-    sum += texture2D(bg_texture, uv + vec2(halfpixel.x * 2.0, 0.0) * offset);
-    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;
-    sum += texture2D(bg_texture, uv + vec2(0.0, -halfpixel.y * 2.0) * offset);
-    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;
-    gl_FragColor = sum / 12.0;
-})";
+#include "kawase-shaders.hpp"
 
 class wf_kawase_blur : public wf_blur_base
 {
@@ -74,7 +18,7 @@ class wf_kawase_blur : public wf_blur_base
     int blur_fb0(const wf::region_t& blur_region, int width, int height) override
     {
         int iterations = iterations_opt;
-        float offset = offset_opt;
+        float offset = get_offset();
         int sampleWidth, sampleHeight;
 
         /* Upload data to shader */
@@ -140,7 +84,7 @@ class wf_kawase_blur : public wf_blur_base
 
     int calculate_blur_radius() override
     {
-        return pow(2, iterations_opt + 1) * offset_opt * degrade_opt;
+        return pow(2, iterations_opt + 1) * get_offset() * get_degrade();
     }
 };
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
 #include <wayfire/nonstd/noncopyable.hpp>
 #include <wayfire/object.hpp>
 #include <wayfire/output.hpp>
@@ -7,6 +11,8 @@
 #include <wayfire/render-manager.hpp>
 #include <wayfire/workspace-stream.hpp>
 #include <wayfire/workspace-manager.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/util.hpp>
 
 namespace wf
 {
@@ -15,6 +21,14 @@ namespace wf
  *
  * Using this interface allows all plugins to use the same OpenGL textures for
  * the workspaces, thereby reducing the memory overhead of a workspace stream.
+ *
+ * If core/prerender_delay is set, the pool also prerenders the streams of the
+ * current and the nearest workspaces once the output has been idle for that
+ * long, so that animations which start using them don't have to render them
+ * from scratch on the first frame. Streams are prerendered at the scale they
+ * were last used with.
+ * These streams are kept running even when plugins stop them, and the damage
+ * they receive is applied the next time they are updated.
  */
 class workspace_stream_pool_t : public noncopyable_t, public wf::custom_data_t
 {
@@ -53,6 +67,8 @@ class workspace_stream_pool_t : public noncopyable_t, public wf::custom_data_t
 
     ~workspace_stream_pool_t()
     {
+        output->render->rem_effect(&on_frame_pre);
+
         OpenGL::render_begin();
         for (auto& row : this->streams)
         {
@@ -79,11 +95,39 @@ class workspace_stream_pool_t : public noncopyable_t, public wf::custom_data_t
      * If the workspace has not been started before, it will be started.
      */
     void update(wf::point_t workspace)
+    {
+        update(workspace, 1, 1);
+    }
+
+    /**
+     * Update the contents of the given workspace, rendering it at the given
+     * scale. See render_manager::workspace_stream_update().
+     *
+     * If the workspace has not been started before, it will be started at
+     * full scale.
+     */
+    void update(wf::point_t workspace, float scale_x, float scale_y)
     {
         auto& stream = get(workspace);
+        auto it = pending_damage.find({workspace.x, workspace.y});
+        if (it != pending_damage.end())
+        {
+            if (stream.running)
+            {
+                /* Damage which is still scheduled doesn't have to be added
+                 * again, this would only trigger another frame */
+                auto ws_box  = output->render->get_ws_box(workspace);
+                auto missing = (it->second + wf::point_t{ws_box.x, ws_box.y}) ^
+                    output->render->get_scheduled_damage();
+                output->render->damage(missing);
+            }
+
+            pending_damage.erase(it);
+        }
+
         if (stream.running)
         {
-            output->render->workspace_stream_update(stream);
+            output->render->workspace_stream_update(stream, scale_x, scale_y);
         } else
         {
             output->render->workspace_stream_start(stream);
@@ -91,14 +135,15 @@ class workspace_stream_pool_t : public noncopyable_t, public wf::custom_data_t
     }
 
     /**
-     * Stop the workspace stream.
+     * Stop the workspace stream. Streams which are prerendered keep running.
      */
     void stop(wf::point_t workspace)
     {
         auto& stream = get(workspace);
-        if (stream.running)
+        if (stream.running && !is_prerendered(workspace))
         {
             output->render->workspace_stream_stop(stream);
+            pending_damage.erase({workspace.x, workspace.y});
         }
     }
 
@@ -117,8 +162,201 @@ class workspace_stream_pool_t : public noncopyable_t, public wf::custom_data_t
                 this->streams[i][j].ws = {i, j};
             }
         }
+
+        last_activity = std::chrono::steady_clock::now();
+        output->render->add_effect(&on_frame_pre, wf::OUTPUT_EFFECT_PRE);
+        schedule_idle_check();
+    }
+
+    wf::option_wrapper_t<int> prerender_delay{"core/prerender_delay"};
+    wf::option_wrapper_t<int> prerender_memory{"core/prerender_memory"};
+    wf::option_wrapper_t<int> prerender_per_frame{"core/prerender_per_frame"};
+
+    /* Damage of running streams which hasn't been applied to them yet,
+     * relative to the workspace */
+    std::map<std::pair<int, int>, wf::region_t> pending_damage;
+
+    /* The time of the last frame which had damage on the visible workspace */
+    std::chrono::steady_clock::time_point last_activity;
+    bool prerendering = false;
+    wf::wl_timer idle_timer;
+
+    /**
+     * Get the workspaces whose streams are prerendered, ordered by their
+     * distance to the current workspace. Their count is limited so that their
+     * buffers fit into the memory budget.
+     */
+    std::vector<wf::point_t> get_prerendered_workspaces() const
+    {
+        int64_t stream_size = 4ll * std::max(output->handle->width, 1) *
+            std::max(output->handle->height, 1);
+        int64_t max_count = int64_t(prerender_memory) * 1024 * 1024 / stream_size;
+        if ((max_count <= 0) || (prerender_delay <= 0))
+        {
+            return {};
+        }
+
+        auto current = output->workspace->get_current_workspace();
+        auto distance = [=] (wf::point_t ws)
+        {
+            return std::max(std::abs(ws.x - current.x), std::abs(ws.y - current.y));
+        };
+
+        std::vector<wf::point_t> workspaces;
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            for (size_t j = 0; j < streams[i].size(); j++)
+            {
+                workspaces.push_back({(int)i, (int)j});
+            }
+        }
+
+        std::stable_sort(workspaces.begin(), workspaces.end(),
+            [&] (wf::point_t a, wf::point_t b) { return distance(a) < distance(b); });
+        if ((int64_t)workspaces.size() > max_count)
+        {
+            workspaces.resize(max_count);
+        }
+
+        return workspaces;
+    }
+
+    bool is_prerendered(wf::point_t workspace) const
+    {
+        auto prerendered = get_prerendered_workspaces();
+        return std::find(prerendered.begin(), prerendered.end(), workspace) !=
+               prerendered.end();
+    }
+
+    bool needs_prerender(wf::point_t workspace)
+    {
+        return !get(workspace).running ||
+               pending_damage.count({workspace.x, workspace.y});
+    }
+
+    /**
+     * Check whether the output is idle after prerender_delay. The check is
+     * repeated only while there is activity, so an idle output isn't woken
+     * up again until something is damaged.
+     */
+    void schedule_idle_check()
+    {
+        if ((prerender_delay <= 0) || idle_timer.is_connected())
+        {
+            return;
+        }
+
+        idle_timer.set_timeout(prerender_delay, [=] ()
+        {
+            if (check_idle())
+            {
+                return true;
+            }
+
+            idle_timer.disconnect();
+            return false;
+        });
+    }
+
+    /**
+     * Start prerendering if the output has been idle for long enough.
+     *
+     * @return Whether the output has to be checked again later.
+     */
+    bool check_idle()
+    {
+        auto idle_time = std::chrono::steady_clock::now() - last_activity;
+        if (prerendering || (prerender_delay <= 0))
+        {
+            return false;
+        }
+
+        if (idle_time < std::chrono::milliseconds(prerender_delay))
+        {
+            return true;
+        }
+
+        for (auto& ws : get_prerendered_workspaces())
+        {
+            if (needs_prerender(ws))
+            {
+                /* The streams are updated in the next frame */
+                prerendering = true;
+                output->render->schedule_redraw();
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Update at most prerender_per_frame streams which need it. The remaining
+     * streams are updated in the next frames.
+     */
+    void prerender()
+    {
+        int budget = std::max(1, (int)prerender_per_frame);
+
+        prerendering = false;
+        for (auto& ws : get_prerendered_workspaces())
+        {
+            if (!needs_prerender(ws))
+            {
+                continue;
+            }
+
+            if (budget-- <= 0)
+            {
+                prerendering = true;
+                output->render->schedule_redraw();
+                return;
+            }
+
+            /* Use the scale of the last user of the stream, so that its
+             * buffer doesn't have to be reallocated when it is used again */
+            auto& stream = get(ws);
+            update(ws, stream.scale_x, stream.scale_y);
+        }
     }
 
+    wf::effect_hook_t on_frame_pre = [=] ()
+    {
+        auto damage = output->render->get_scheduled_damage();
+        if (!(damage & output->get_relative_geometry()).empty())
+        {
+            last_activity = std::chrono::steady_clock::now();
+            prerendering  = false;
+            schedule_idle_check();
+        }
+
+        /* Remember the damage of streams which might not be updated in this
+         * frame, because it is cleared at the end of the frame */
+        for (auto& row : streams)
+        {
+            for (auto& stream : row)
+            {
+                if (!stream.running)
+                {
+                    continue;
+                }
+
+                auto ws_box    = output->render->get_ws_box(stream.ws);
+                auto ws_damage = damage & ws_box;
+                if (!ws_damage.empty())
+                {
+                    pending_damage[{stream.ws.x, stream.ws.y}] |=
+                        ws_damage + wf::point_t{-ws_box.x, -ws_box.y};
+                }
+            }
+        }
+
+        if (prerendering)
+        {
+            prerender();
+        }
+    };
+
     /** Number of active users of this instance */
     uint32_t ref_count = 0;
 
@@ -1,6 +1,8 @@
 #pragma once
 
 
+#include <cmath>
+#include <map>
 #include <glm/gtc/matrix_transform.hpp>
 #include "workspace-stream-sharing.hpp"
 
@@ -10,12 +12,15 @@ namespace wf
  * When the workspace wall is rendered via a render hook, the frame event
  * is emitted on each frame.
  *
- * The target framebuffer is passed as signal data.
+ * The target framebuffer is passed as signal data, together with the region
+ * of it which was repainted in this frame.
  */
 struct wall_frame_event_t : public signal_data_t
 {
     const wf::framebuffer_t& target;
-    wall_frame_event_t(const wf::framebuffer_t& t) : target(t)
+    const wf::region_t& damage;
+    wall_frame_event_t(const wf::framebuffer_t& t, const wf::region_t& d) :
+        target(t), damage(d)
     {}
 };
 
@@ -32,6 +37,7 @@ class workspace_wall_t : public wf::signal_provider_t
     {
         this->viewport = get_wall_rectangle();
         streams = workspace_stream_pool_t::ensure_pool(output);
+        output->render->connect_signal("workspace-stream-pre", &on_stream_pre);
     }
 
     ~workspace_wall_t()
@@ -48,6 +54,7 @@ class workspace_wall_t : public wf::signal_provider_t
     void set_background_color(const wf::color_t& color)
     {
         this->background_color = color;
+        this->needs_full_repaint = true;
     }
 
     /**
@@ -59,6 +66,37 @@ class workspace_wall_t : public wf::signal_provider_t
     void set_gap_size(int size)
     {
         this->gap_size = size;
+        this->needs_full_repaint = true;
+    }
+
+    /**
+     * When the wall is rendered via a render hook and the viewport doesn't
+     * change, repaint only the parts of the output where the workspace streams
+     * changed, instead of the whole output.
+     *
+     * Listeners of the frame event which render on top of the wall should
+     * enable this only if they draw only inside the damage of the event.
+     *
+     * @param enabled Whether to repaint only the damaged parts of the output.
+     */
+    void set_partial_repaint(bool enabled)
+    {
+        this->partial_repaint = enabled;
+        this->needs_full_repaint = true;
+    }
+
+    /**
+     * Limit the number of workspace streams updated per frame. The stream of
+     * the current workspace is always updated, and of the other visible
+     * workspaces at most the given number, in a round-robin fashion. Streams
+     * which are skipped keep their damage until they are updated.
+     *
+     * @param budget The maximal number of streams of workspaces other than
+     *   the current one to update each frame, or 0 for no limit.
+     */
+    void set_stream_update_budget(int budget)
+    {
+        this->stream_update_budget = std::max(budget, 0);
     }
 
     /**
@@ -87,6 +125,8 @@ class workspace_wall_t : public wf::signal_provider_t
             if (it == newly_visible.end())
             {
                 streams->stop(old);
+                /* The stream is repainted fully when it is started again */
+                pending_stream_damage.erase({old.x, old.y});
             }
         }
 
@@ -96,35 +136,25 @@ class workspace_wall_t : public wf::signal_provider_t
     /**
      * Render the selected viewport on the framebuffer.
      *
+     * If the viewport has the same size as the target geometry, the views of
+     * the workspaces are rendered directly onto the framebuffer. Otherwise,
+     * the workspaces are rendered to workspace streams first.
+     *
      * @param fb The framebuffer to render on.
      * @param geometry The rectangle in fb to draw to, in the same coordinate
      *   system as the framebuffer's geometry.
      */
     void render_wall(const wf::framebuffer_t& fb, wf::geometry_t geometry)
     {
-        update_streams();
-
-        OpenGL::render_begin(fb);
-        fb.logic_scissor(geometry);
-
-        OpenGL::clear(this->background_color);
-        auto wall_matrix =
-            calculate_viewport_transformation_matrix(this->viewport, geometry);
-        /* After all transformations of the framebuffer, the workspace should
-         * span the visible part of the OpenGL coordinate space. */
-        const wf::geometry_t workspace_geometry = {-1, 1, 2, -2};
-        for (auto& ws : get_visible_workspaces(this->viewport))
+        if (is_unscaled(geometry))
         {
-            auto ws_matrix = calculate_workspace_matrix(ws);
-            OpenGL::render_transformed_texture(
-                streams->get(ws).buffer.tex, workspace_geometry,
-                fb.get_orthographic_projection() * wall_matrix * ws_matrix);
+            stop_visible_streams();
+            render_wall_direct(fb, geometry, geometry);
+        } else
+        {
+            update_streams(geometry);
+            render_wall_region(fb, geometry, geometry);
         }
-
-        OpenGL::render_end();
-
-        wall_frame_event_t data{fb};
-        this->emit_signal("frame", &data);
     }
 
     /**
@@ -136,7 +166,8 @@ class workspace_wall_t : public wf::signal_provider_t
         if (!render_hook_set)
         {
             this->output->render->set_renderer(on_render);
-            render_hook_set = true;
+            render_hook_set    = true;
+            needs_full_repaint = true;
         }
     }
 
@@ -203,13 +234,270 @@ class workspace_wall_t : public wf::signal_provider_t
     wf::geometry_t viewport = {0, 0, 0, 0};
     nonstd::observer_ptr<workspace_stream_pool_t> streams;
 
-    /** Update or start visible streams */
-    void update_streams()
+    bool partial_repaint    = false;
+    bool needs_full_repaint = true;
+    /* The viewport and target geometry of the last frame rendered by the
+     * render hook */
+    wf::geometry_t last_viewport = {0, 0, 0, 0};
+    wf::geometry_t last_geometry = {0, 0, 0, 0};
+
+    int stream_update_budget = 0;
+    /* Index in the list of visible workspaces to continue updating from */
+    size_t next_stream_update = 0;
+    /* Damage of streams which were skipped because of the update budget,
+     * relative to the workspace */
+    std::map<std::pair<int, int>, wf::region_t> pending_stream_damage;
+
+    /* The damage of the updated streams, mapped to the target geometry */
+    bool tracking_stream_damage = false;
+    wf::geometry_t stream_damage_target;
+    wf::region_t stream_damage;
+
+    /**
+     * Update or start visible streams, and collect their damage.
+     *
+     * @param geometry The rectangle which the viewport will be rendered to.
+     */
+    void update_streams(wf::geometry_t geometry)
+    {
+        stream_damage.clear();
+        stream_damage_target   = geometry;
+        tracking_stream_damage = true;
+
+        auto visible = get_visible_workspaces(viewport);
+        auto current = output->workspace->get_current_workspace();
+        int budget   = stream_update_budget;
+        for (size_t i = 0; i < visible.size(); i++)
+        {
+            size_t idx = (next_stream_update + i) % visible.size();
+            auto ws    = visible[idx];
+            if ((stream_update_budget <= 0) || (ws == current) ||
+                !streams->get(ws).running)
+            {
+                update_stream(ws);
+                continue;
+            }
+
+            auto damage = output->render->get_scheduled_damage() &
+                output->render->get_ws_box(ws);
+            if (damage.empty() && !pending_stream_damage.count({ws.x, ws.y}))
+            {
+                continue;
+            }
+
+            if (budget > 0)
+            {
+                --budget;
+                next_stream_update = idx + 1;
+                update_stream(ws);
+            } else
+            {
+                auto ws_box = output->render->get_ws_box(ws);
+                pending_stream_damage[{ws.x, ws.y}] |=
+                    damage + wf::point_t{-ws_box.x, -ws_box.y};
+            }
+        }
+
+        tracking_stream_damage = false;
+        if (!pending_stream_damage.empty())
+        {
+            output->render->schedule_redraw();
+        }
+    }
+
+    /** Update a single stream, restoring damage which was left pending */
+    void update_stream(wf::point_t ws)
+    {
+        auto it = pending_stream_damage.find({ws.x, ws.y});
+        if (it != pending_stream_damage.end())
+        {
+            auto ws_box = output->render->get_ws_box(ws);
+            output->render->damage(it->second + wf::point_t{ws_box.x, ws_box.y});
+            pending_stream_damage.erase(it);
+        }
+
+        streams->update(ws);
+    }
+
+    wf::signal_connection_t on_stream_pre = [=] (wf::signal_data_t *data)
+    {
+        if (!tracking_stream_damage)
+        {
+            return;
+        }
+
+        auto ev     = static_cast<wf::stream_signal_t*>(data);
+        auto ws_box = output->render->get_ws_box(ev->ws);
+        auto target = get_workspace_rectangle(ev->ws);
+        for (const auto& rect : ev->raw_damage)
+        {
+            auto box = wlr_box_from_pixman_box(rect);
+            box.x += target.x - ws_box.x;
+            box.y += target.y - ws_box.y;
+            stream_damage |= wall_to_target(box, stream_damage_target);
+        }
+    };
+
+    /**
+     * Whether the viewport is rendered to the given geometry without scaling.
+     * In this case, the workspaces are rendered directly onto the target
+     * framebuffer, without workspace streams.
+     */
+    bool is_unscaled(wf::geometry_t geometry) const
+    {
+        return (geometry.width == viewport.width) &&
+               (geometry.height == viewport.height);
+    }
+
+    /**
+     * Stop the streams of the visible workspaces, because they aren't updated
+     * while rendering directly. They are repainted fully when started again.
+     */
+    void stop_visible_streams()
+    {
+        for (auto& ws : get_visible_workspaces(viewport))
+        {
+            streams->stop(ws);
+            pending_stream_damage.erase({ws.x, ws.y});
+        }
+    }
+
+    /**
+     * Calculate the part of the target geometry which needs to be repainted
+     * when rendering directly, based on the damage scheduled on the output.
+     */
+    wf::region_t get_direct_damage(wf::geometry_t geometry) const
+    {
+        auto scheduled = output->render->get_scheduled_damage();
+
+        /* The scheduled damage contains the parts of the output which are
+         * outdated in the current buffer */
+        wf::region_t damage = scheduled;
+        for (auto& ws : get_visible_workspaces(viewport))
+        {
+            auto ws_box = output->render->get_ws_box(ws);
+            auto target = get_workspace_rectangle(ws);
+            for (const auto& rect : scheduled & ws_box)
+            {
+                auto box = wlr_box_from_pixman_box(rect);
+                box.x += target.x - ws_box.x;
+                box.y += target.y - ws_box.y;
+                damage |= wall_to_target(box, geometry);
+            }
+        }
+
+        return damage & geometry;
+    }
+
+    /**
+     * Render the given region of the viewport by rendering the views of each
+     * workspace directly onto the framebuffer. The viewport must be unscaled.
+     */
+    void render_wall_direct(const wf::framebuffer_t& fb, wf::geometry_t geometry,
+        const wf::region_t& damage)
     {
+        OpenGL::render_begin(fb);
+        for (const auto& rect : damage)
+        {
+            fb.logic_scissor(wlr_box_from_pixman_box(rect));
+            OpenGL::clear(this->background_color);
+        }
+
+        OpenGL::render_end();
+
         for (auto& ws : get_visible_workspaces(viewport))
         {
-            streams->update(ws);
+            auto target = get_workspace_rectangle(ws);
+            wf::point_t position = {
+                target.x - viewport.x + geometry.x,
+                target.y - viewport.y + geometry.y,
+            };
+            output->render->render_workspace(ws, fb, position, damage);
+        }
+
+        wall_frame_event_t data{fb, damage};
+        this->emit_signal("frame", &data);
+    }
+
+    /**
+     * Map a box in the wall coordinate system to the box in the target geometry
+     * which covers it when the current viewport is rendered there.
+     */
+    wf::geometry_t wall_to_target(wf::geometry_t box, wf::geometry_t target) const
+    {
+        const double scale_x = target.width * 1.0 / viewport.width;
+        const double scale_y = target.height * 1.0 / viewport.height;
+
+        int x1 = std::floor((box.x - viewport.x) * scale_x + target.x);
+        int y1 = std::floor((box.y - viewport.y) * scale_y + target.y);
+        int x2 = std::ceil((box.x + box.width - viewport.x) * scale_x + target.x);
+        int y2 = std::ceil((box.y + box.height - viewport.y) * scale_y + target.y);
+
+        /* Leave a margin for the texture filtering */
+        return {x1 - 1, y1 - 1, x2 - x1 + 2, y2 - y1 + 2};
+    }
+
+    /**
+     * Render the given region of the viewport.
+     *
+     * @param fb The framebuffer to render on.
+     * @param geometry The rectangle in fb to draw the viewport to.
+     * @param damage The part of geometry to repaint.
+     */
+    void render_wall_region(const wf::framebuffer_t& fb, wf::geometry_t geometry,
+        const wf::region_t& damage)
+    {
+        auto wall_matrix =
+            calculate_viewport_transformation_matrix(this->viewport, geometry);
+        /* After all transformations of the framebuffer, the workspace should
+         * span the visible part of the OpenGL coordinate space. */
+        const wf::geometry_t workspace_geometry = {-1, 1, 2, -2};
+
+        /* When the workspaces are shrunk (for ex. in expo), sample them with
+         * mipmaps to avoid aliasing and reading the whole texture. */
+        const bool use_mipmaps = OpenGL::supports_npot_mipmaps() &&
+            (geometry.width < viewport.width) &&
+            (geometry.height < viewport.height);
+
+        auto visible = get_visible_workspaces(this->viewport);
+        OpenGL::render_begin(fb);
+        for (auto& ws : visible)
+        {
+            auto& stream = streams->get(ws);
+            if (use_mipmaps && !stream.has_mipmaps)
+            {
+                GL_CALL(glBindTexture(GL_TEXTURE_2D, stream.buffer.tex));
+                GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
+                stream.has_mipmaps = true;
+            }
+        }
+
+        for (const auto& rect : damage)
+        {
+            auto box = wlr_box_from_pixman_box(rect);
+            fb.logic_scissor(box);
+            OpenGL::clear(this->background_color);
+
+            for (auto& ws : visible)
+            {
+                auto ws_box = wall_to_target(get_workspace_rectangle(ws), geometry);
+                if (!(ws_box & box))
+                {
+                    continue;
+                }
+
+                auto ws_matrix = calculate_workspace_matrix(ws);
+                OpenGL::render_transformed_texture(
+                    streams->get(ws).buffer.tex, workspace_geometry,
+                    fb.get_orthographic_projection() * wall_matrix * ws_matrix,
+                    glm::vec4(1.0), use_mipmaps ? OpenGL::TEXTURE_USE_MIPMAPS : 0);
+            }
         }
+
+        OpenGL::render_end();
+
+        wall_frame_event_t data{fb, damage};
+        this->emit_signal("frame", &data);
     }
 
     /**
@@ -279,7 +567,49 @@ class workspace_wall_t : public wf::signal_provider_t
     bool render_hook_set = false;
     wf::render_hook_t on_render = [=] (const wf::framebuffer_t& target)
     {
-        render_wall(target, this->output->get_relative_geometry());
+        auto geometry = this->output->get_relative_geometry();
+        const bool direct = is_unscaled(geometry);
+        if (direct)
+        {
+            stop_visible_streams();
+        } else
+        {
+            update_streams(geometry);
+        }
+
+        const bool is_static = partial_repaint && !needs_full_repaint &&
+            (viewport == last_viewport) && (geometry == last_geometry);
+        last_viewport = viewport;
+        last_geometry = geometry;
+        needs_full_repaint = false;
+        if (!is_static)
+        {
+            if (direct)
+            {
+                render_wall_direct(target, geometry, geometry);
+            } else
+            {
+                render_wall_region(target, geometry, geometry);
+            }
+
+            return;
+        }
+
+        if (direct)
+        {
+            auto damage = get_direct_damage(geometry);
+            render_wall_direct(target, geometry, damage);
+            output->render->set_renderer_damage(damage);
+        } else
+        {
+            /* The scheduled damage contains the parts of the output which are
+             * outdated in the current buffer */
+            wf::region_t damage =
+                output->render->get_scheduled_damage() | stream_damage;
+            damage &= geometry;
+            render_wall_region(target, geometry, damage);
+            output->render->set_renderer_damage(damage);
+        }
     };
 };
 }
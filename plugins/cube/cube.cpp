@@ -10,6 +10,7 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <wayfire/img.hpp>
+#include <algorithm>
 
 #include "cube.hpp"
 #include "simple-background.hpp"
@@ -23,6 +24,9 @@
 #define ZOOM_MAX 10.0f
 #define ZOOM_MIN 0.1f
 
+/* The smallest resolution of the workspace streams, relative to the output */
+#define MIN_STREAM_SCALE 0.25f
+
 #ifdef USE_GLES32
     #include <GLES3/gl32.h>
 #endif
@@ -78,7 +82,7 @@ class wayfire_cube : public wf::plugin_interface_t
             background = std::make_unique<wf_cube_background_skydome>(output);
         } else if (last_background_mode == "cubemap")
         {
-            background = std::make_unique<wf_cube_background_cubemap>();
+            background = std::make_unique<wf_cube_background_cubemap>(output);
         } else
         {
             LOGE("cube: Unrecognized background mode %s. Using default \"simple\"",
@@ -94,6 +98,21 @@ class wayfire_cube : public wf::plugin_interface_t
         return output->workspace->get_workspace_grid_size().width;
     }
 
+    /* The visibility of each face of the cube in the current frame, indexed
+     * like in render_cube() */
+    struct face_visibility_t
+    {
+        bool visible = true;
+        /* The resolution of the face's workspace stream, relative to the
+         * output */
+        float scale = 1.0;
+    };
+
+    std::vector<face_visibility_t> faces;
+    /* Workspace columns whose streams were not updated while their face was
+     * hidden, so they missed damage and have to be fully repainted */
+    std::vector<bool> stale_streams;
+
   public:
     void init() override
     {
@@ -311,6 +330,9 @@ class wayfire_cube : public wf::plugin_interface_t
         {
             streams->stop({i, cws.y});
         }
+
+        /* Stopped streams are repainted fully when they are started again */
+        stale_streams.clear();
     }
 
     /* Sets attributes target to such values that the cube effect isn't visible,
@@ -423,12 +445,127 @@ class wayfire_cube : public wf::plugin_interface_t
         animation.view = zoom_translate * rotation * view;
     }
 
+    /**
+     * Find out which faces of the cube can be seen with the given view
+     * projection matrix, and how big they are on the screen.
+     *
+     * A face is hidden if it lies completely outside of the view frustum, or
+     * if it faces away from the camera and the inside of the cube cannot be
+     * seen through its open top or bottom. When the cube is deformed, all
+     * faces are treated as visible.
+     */
+    void update_face_visibility(const glm::mat4& vp, glm::mat4 fb_transform)
+    {
+        const int num_faces = get_num_faces();
+        faces.assign(num_faces, face_visibility_t{});
+
+        bool deformed = tessellation_support && (use_deform > 0) &&
+            (animation.cube_animation.ease_deformation > 0);
+        if (deformed || (num_faces < 3))
+        {
+            return;
+        }
+
+        float zoom_factor = animation.cube_animation.zoom;
+        auto scale_matrix = glm::scale(glm::mat4(1.0),
+            glm::vec3(1. / zoom_factor, 1. / zoom_factor, 1. / zoom_factor));
+        glm::vec4 camera = glm::inverse(animation.view * scale_matrix) *
+            glm::vec4(0, 0, 0, 1);
+
+        /* The sides span y in [-0.5, 0.5], and the corners of the cube are at
+         * the circumradius from its axis */
+        float circumradius = 0.5 / std::sin(animation.side_angle / 2);
+        bool inside_visible = (std::abs(camera.y) > 0.5) ||
+            (glm::length(glm::vec2(camera.x, camera.z)) < circumradius);
+
+        static const glm::vec4 corners[] = {
+            {-0.5, 0.5, 0, 1}, {0.5, 0.5, 0, 1},
+            {0.5, -0.5, 0, 1}, {-0.5, -0.5, 0, 1},
+        };
+
+        for (int i = 0; i < num_faces; i++)
+        {
+            auto model = calculate_model_matrix(i, fb_transform);
+            glm::vec4 center = model * glm::vec4(0, 0, 0, 1);
+            glm::vec4 normal = model * glm::vec4(0, 0, 1, 0);
+            if (!inside_visible &&
+                (glm::dot(glm::vec3(normal), glm::vec3(camera - center)) <= 0))
+            {
+                faces[i].visible = false;
+                continue;
+            }
+
+            /* Count the corners outside of each clipping plane */
+            int outside[5] = {0, 0, 0, 0, 0};
+            glm::vec2 min_ndc{1, 1}, max_ndc{-1, -1};
+            for (auto& corner : corners)
+            {
+                glm::vec4 clip = vp * model * corner;
+                outside[0] += (clip.x < -clip.w);
+                outside[1] += (clip.x > clip.w);
+                outside[2] += (clip.y < -clip.w);
+                outside[3] += (clip.y > clip.w);
+                outside[4] += (clip.w <= 0);
+
+                if (clip.w > 0)
+                {
+                    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                    min_ndc = glm::min(min_ndc, ndc);
+                    max_ndc = glm::max(max_ndc, ndc);
+                }
+            }
+
+            if (std::find(std::begin(outside), std::end(outside), 4) !=
+                std::end(outside))
+            {
+                faces[i].visible = false;
+                continue;
+            }
+
+            if (outside[4] > 0)
+            {
+                /* Partially behind the camera, can't reliably estimate size */
+                continue;
+            }
+
+            /* The fraction of the output covered by the face. The streams
+             * support only uniform scaling, so the larger of the two is
+             * used, and it is rounded up to a power of two, so that the
+             * streams don't have to be reallocated on every frame. */
+            glm::vec2 covered = glm::min((max_ndc - min_ndc) / 2.0f, 1.0f);
+            float needed = std::max(covered.x, covered.y);
+            while (faces[i].scale / 2 >= needed &&
+                   faces[i].scale / 2 >= MIN_STREAM_SCALE)
+            {
+                faces[i].scale /= 2;
+            }
+        }
+    }
+
     void update_workspace_streams()
     {
         auto cws = output->workspace->get_current_workspace();
+        stale_streams.resize(get_num_faces(), false);
+
         for (int i = 0; i < get_num_faces(); i++)
         {
-            streams->update({i, cws.y});
+            int index = (cws.x + i) % get_num_faces();
+            if (!faces[i].visible)
+            {
+                stale_streams[index] = true;
+                continue;
+            }
+
+            auto& stream = streams->get({index, cws.y});
+            bool stale = stale_streams[index];
+            stale_streams[index] = false;
+            if (stale && stream.running)
+            {
+                /* Starting the stream repaints it fully anyway */
+                output->render->damage(output->render->get_ws_box({index, cws.y}));
+            }
+
+            streams->update({index, cws.y}, faces[i].scale, faces[i].scale);
         }
     }
 
@@ -464,6 +601,11 @@ class wayfire_cube : public wf::plugin_interface_t
         auto cws = output->workspace->get_current_workspace();
         for (int i = 0; i < get_num_faces(); i++)
         {
+            if (!faces[i].visible)
+            {
+                continue;
+            }
+
             int index = (cws.x + i) % get_num_faces();
             GL_CALL(glBindTexture(GL_TEXTURE_2D,
                 streams->get({index, cws.y}).buffer.tex));
@@ -486,6 +628,8 @@ class wayfire_cube : public wf::plugin_interface_t
 
     void render(const wf::framebuffer_t& dest)
     {
+        auto vp = calculate_vp_matrix(dest);
+        update_face_visibility(vp, dest.transform);
         update_workspace_streams();
         if (program.get_program_id(wf::TEXTURE_TYPE_RGBA) == 0)
         {
@@ -499,8 +643,6 @@ class wayfire_cube : public wf::plugin_interface_t
         reload_background();
         background->render_frame(dest, animation);
 
-        auto vp = calculate_vp_matrix(dest);
-
         OpenGL::render_begin(dest);
         program.use(wf::TEXTURE_TYPE_RGBA);
         GL_CALL(glEnable(GL_DEPTH_TEST));
@@ -4,17 +4,20 @@
 #include <config.h>
 #include <wayfire/core.hpp>
 #include <wayfire/img.hpp>
+#include <wayfire/render-manager.hpp>
 
 #include "cubemap-shaders.tpp"
 
-wf_cube_background_cubemap::wf_cube_background_cubemap()
+wf_cube_background_cubemap::wf_cube_background_cubemap(wf::output_t *output)
 {
+    this->output = output;
     create_program();
     reload_texture();
 }
 
 wf_cube_background_cubemap::~wf_cube_background_cubemap()
 {
+    *alive = false;
     OpenGL::render_begin();
     program.free_resources();
     OpenGL::render_end();
@@ -36,8 +39,42 @@ void wf_cube_background_cubemap::reload_texture()
     }
 
     last_background_image = background_image;
+    loading = true;
+
+    /* Decode the image in the background, the old texture (if any) is used
+     * until it is ready */
+    auto alive = this->alive;
+    auto name  = last_background_image;
+    image_io::load_from_file_async(name,
+        [=] (std::shared_ptr<const image_io::image_t> image)
+    {
+        if (*alive && (name == last_background_image))
+        {
+            upload_texture(image.get());
+        }
+    });
+}
 
+void wf_cube_background_cubemap::upload_texture(const image_io::image_t *image)
+{
+    loading = false;
     OpenGL::render_begin();
+    if (!image)
+    {
+        LOGE("Failed to load cubemap background image from \"%s\".",
+            last_background_image.c_str());
+        if (tex != (uint32_t)-1)
+        {
+            GL_CALL(glDeleteTextures(1, &tex));
+            tex = -1;
+        }
+
+        OpenGL::render_end();
+        output->render->schedule_redraw();
+
+        return;
+    }
+
     if (tex == (uint32_t)-1)
     {
         GL_CALL(glGenTextures(1, &tex));
@@ -46,34 +83,23 @@ void wf_cube_background_cubemap::reload_texture()
     GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
     for (int i = 0; i < 6; i++)
     {
-        if (!image_io::load_from_file(last_background_image,
-            GL_TEXTURE_CUBE_MAP_POSITIVE_X + i))
-        {
-            LOGE("Failed to load cubemap background image from \"%s\".",
-                last_background_image.c_str());
-
-            GL_CALL(glDeleteTextures(1, &tex));
-            tex = -1;
-            break;
-        }
+        image_io::upload_to_texture(*image, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
     }
 
-    if (tex != (uint32_t)-1)
-    {
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
-            GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER,
-            GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,
-            GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,
-            GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,
-            GL_CLAMP_TO_EDGE));
-    }
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+        GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER,
+        GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,
+        GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,
+        GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,
+        GL_CLAMP_TO_EDGE));
 
     GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
     OpenGL::render_end();
+    output->render->schedule_redraw();
 }
 
 #include "cubemap-vertex-data.hpp"
@@ -86,7 +112,14 @@ void wf_cube_background_cubemap::render_frame(const wf::framebuffer_t& fb,
     OpenGL::render_begin(fb);
     if (tex == (uint32_t)-1)
     {
-        GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        if (loading)
+        {
+            GL_CALL(glClearColor(0.0, 0.0, 0.0, 1.0));
+        } else
+        {
+            GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        }
+
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
         OpenGL::render_end();
 
@@ -2,11 +2,14 @@
 #define WF_CUBE_CUBEMAP_HPP
 
 #include "cube-background.hpp"
+#include <wayfire/img.hpp>
+#include <wayfire/output.hpp>
+#include <memory>
 
 class wf_cube_background_cubemap : public wf_cube_background_base
 {
   public:
-    wf_cube_background_cubemap();
+    wf_cube_background_cubemap(wf::output_t *output);
     virtual void render_frame(const wf::framebuffer_t& fb,
         wf_cube_animation_attribs& attribs) override;
 
@@ -14,10 +17,16 @@ class wf_cube_background_cubemap : public wf_cube_background_base
 
   private:
     void reload_texture();
+    void upload_texture(const image_io::image_t *image);
     void create_program();
 
+    wf::output_t *output;
     OpenGL::program_t program;
     GLuint tex = -1;
+    /* Whether the image is still being decoded */
+    bool loading = false;
+    /* Reset in the destructor, so that pending loads are ignored */
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
 
     std::string last_background_image;
     wf::option_wrapper_t<std::string> background_image{"cube/cubemap_image"};
@@ -21,6 +21,7 @@ wf_cube_background_skydome::wf_cube_background_skydome(wf::output_t *output)
 
 wf_cube_background_skydome::~wf_cube_background_skydome()
 {
+    *alive = false;
     OpenGL::render_begin();
     program.deactivate();
     OpenGL::render_end();
@@ -41,7 +42,40 @@ void wf_cube_background_skydome::reload_texture()
     }
 
     last_background_image = background_image;
+    loading = true;
+
+    /* Decode the image in the background, the old texture (if any) is used
+     * until it is ready */
+    auto alive = this->alive;
+    auto name  = last_background_image;
+    image_io::load_from_file_async(name,
+        [=] (std::shared_ptr<const image_io::image_t> image)
+    {
+        if (*alive && (name == last_background_image))
+        {
+            upload_texture(image.get());
+        }
+    });
+}
+
+void wf_cube_background_skydome::upload_texture(const image_io::image_t *image)
+{
+    loading = false;
     OpenGL::render_begin();
+    if (!image)
+    {
+        LOGE("Failed to load skydome image from \"%s\".",
+            last_background_image.c_str());
+        if (tex != (uint32_t)-1)
+        {
+            GL_CALL(glDeleteTextures(1, &tex));
+            tex = -1;
+        }
+
+        OpenGL::render_end();
+
+        return;
+    }
 
     if (tex == (uint32_t)-1)
     {
@@ -49,24 +83,15 @@ void wf_cube_background_skydome::reload_texture()
     }
 
     GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
-
-    if (image_io::load_from_file(last_background_image, GL_TEXTURE_2D))
-    {
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    } else
-    {
-        LOGE("Failed to load skydome image from \"%s\".",
-            last_background_image.c_str());
-        GL_CALL(glDeleteTextures(1, &tex));
-        tex = -1;
-    }
-
+    image_io::upload_to_texture(*image, GL_TEXTURE_2D);
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
     GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
 
     OpenGL::render_end();
+    output->render->schedule_redraw();
 }
 
 void wf_cube_background_skydome::fill_vertices()
@@ -132,7 +157,14 @@ void wf_cube_background_skydome::render_frame(const wf::framebuffer_t& fb,
 
     if (tex == (uint32_t)-1)
     {
-        GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        if (loading)
+        {
+            GL_CALL(glClearColor(0.0, 0.0, 0.0, 1.0));
+        } else
+        {
+            GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        }
+
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
 
         return;
@@ -3,6 +3,8 @@
 
 #include "cube-background.hpp"
 #include "wayfire/output.hpp"
+#include <wayfire/img.hpp>
+#include <memory>
 #include <vector>
 
 class wf_cube_background_skydome : public wf_cube_background_base
@@ -20,9 +22,14 @@ class wf_cube_background_skydome : public wf_cube_background_base
     void load_program();
     void fill_vertices();
     void reload_texture();
+    void upload_texture(const image_io::image_t *image);
 
     OpenGL::program_t program;
     GLuint tex = -1;
+    /* Whether the image is still being decoded */
+    bool loading = false;
+    /* Reset in the destructor, so that pending loads are ignored */
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
 
     std::vector<GLfloat> vertices;
     std::vector<GLfloat> coords;
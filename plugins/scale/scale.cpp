@@ -38,7 +38,9 @@ class wf_scale : public wf::view_2D
 {
   public:
     wf_scale(wayfire_view view) : wf::view_2D(view)
-    {}
+    {
+        use_thumbnail = true;
+    }
     ~wf_scale()
     {}
 
@@ -57,6 +57,7 @@ class wayfire_expo : public wf::plugin_interface_t
     wf::option_wrapper_t<wf::color_t> background_color{"expo/background"};
     wf::option_wrapper_t<int> zoom_duration{"expo/duration"};
     wf::option_wrapper_t<int> delimiter_offset{"expo/offset"};
+    wf::option_wrapper_t<int> max_stream_updates{"expo/max_stream_updates"};
     wf::geometry_animation_t zoom_animation{zoom_duration};
 
 
@@ -143,6 +144,7 @@ class wayfire_expo : public wf::plugin_interface_t
         setup_workspace_bindings_from_config();
         wall = std::make_unique<wf::workspace_wall_t>(this->output);
         wall->connect_signal("frame", &on_frame);
+        wall->set_partial_repaint(true);
 
         output->add_activator(toggle_binding, &toggle_cb);
         grab_interface->callbacks.pointer.button =
@@ -280,6 +282,7 @@ class wayfire_expo : public wf::plugin_interface_t
     {
         wall->set_background_color(background_color);
         wall->set_gap_size(this->delimiter_offset);
+        wall->set_stream_update_budget(max_stream_updates);
         if (zoom_in)
         {
             zoom_animation.set_start(wall->get_workspace_rectangle(
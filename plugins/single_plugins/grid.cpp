@@ -4,6 +4,7 @@
 #include <wayfire/view.hpp>
 #include <wayfire/workspace-manager.hpp>
 #include <wayfire/render-manager.hpp>
+#include <wayfire/layout-transaction.hpp>
 #include <algorithm>
 #include <cmath>
 #include <linux/input-event-codes.h>
@@ -72,7 +73,14 @@ class wayfire_grid_view_cdata : public wf::custom_data_t
         view->erase_data<wayfire_grid_view_cdata>();
     }
 
-    void adjust_target_geometry(wf::geometry_t geometry, int32_t target_edges)
+    /**
+     * Start moving the view to the given geometry.
+     *
+     * @param transaction If not null, and the view is not animated, its new
+     *   geometry is added to the transaction instead of being set directly.
+     */
+    void adjust_target_geometry(wf::geometry_t geometry, int32_t target_edges,
+        wf::layout_transaction_t *transaction = nullptr)
     {
         animation.set_start(view->get_wm_geometry());
         animation.set_end(geometry);
@@ -95,7 +103,7 @@ class wayfire_grid_view_cdata : public wf::custom_data_t
 
         if (type == "none")
         {
-            set_end_state(geometry, tiled_edges);
+            set_end_state(geometry, tiled_edges, transaction);
 
             return destroy();
         }
@@ -117,14 +125,21 @@ class wayfire_grid_view_cdata : public wf::custom_data_t
         animation.start();
     }
 
-    void set_end_state(wf::geometry_t geometry, int32_t edges)
+    void set_end_state(wf::geometry_t geometry, int32_t edges,
+        wf::layout_transaction_t *transaction = nullptr)
     {
         if (edges >= 0)
         {
             view->set_tiled(edges);
         }
 
-        view->set_geometry(geometry);
+        if (transaction)
+        {
+            transaction->set_geometry(view, geometry);
+        } else
+        {
+            view->set_geometry(geometry);
+        }
     }
 
     void adjust_geometry()
@@ -303,7 +318,8 @@ class wayfire_grid : public wf::plugin_interface_t
                workspace_impl->view_resizable(view);
     }
 
-    void handle_slot(wayfire_view view, int slot, wf::point_t delta = {0, 0})
+    void handle_slot(wayfire_view view, int slot, wf::point_t delta = {0, 0},
+        wf::layout_transaction_t *transaction = nullptr)
     {
         if (!can_adjust_view(view))
         {
@@ -313,7 +329,7 @@ class wayfire_grid : public wf::plugin_interface_t
         view->get_data_safe<wf_grid_slot_data>()->slot = slot;
         ensure_grid_view(view)->adjust_target_geometry(
             get_slot_dimensions(slot) + delta,
-            get_tiled_edges_for_slot(slot));
+            get_tiled_edges_for_slot(slot), transaction);
     }
 
     /*
@@ -351,6 +367,9 @@ class wayfire_grid : public wf::plugin_interface_t
     wf::signal_callback_t on_workarea_changed = [=] (wf::signal_data_t *data)
     {
         auto ev = static_cast<wf::workarea_changed_signal*>(data);
+
+        /* Views which are not animated are moved to their new slots at once */
+        wf::layout_transaction_t transaction;
         for (auto& view : output->workspace->get_views_in_layer(wf::LAYER_WORKSPACE))
         {
             if (!view->is_mapped())
@@ -382,7 +401,8 @@ class wayfire_grid : public wf::plugin_interface_t
             int vy = std::floor(1.0 * wm.y / output_geometry.height);
 
             handle_slot(view, data->slot,
-                {vx *output_geometry.width, vy * output_geometry.height});
+                {vx *output_geometry.width, vy * output_geometry.height},
+                &transaction);
         }
     };
 
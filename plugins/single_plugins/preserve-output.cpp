@@ -75,9 +75,6 @@ void view_erase_data(wayfire_view view)
  * Core preserve-output info
  */
 
-wf::option_wrapper_t<int> last_output_focus_timeout{
-    "preserve-output/last_output_focus_timeout"};
-
 class preserve_output_t : public wf::custom_data_t
 {
   public:
@@ -93,6 +90,9 @@ nonstd::observer_ptr<preserve_output_t> get_preserve_output_data()
 
 bool core_focused_output_expired()
 {
+    static wf::option_wrapper_t<int> last_output_focus_timeout{
+        "preserve-output/last_output_focus_timeout"};
+
     using namespace std::chrono;
     const auto now = steady_clock::now();
     const auto last_focus_ts =
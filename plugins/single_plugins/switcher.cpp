@@ -544,8 +544,9 @@ class WayfireSwitcher : public wf::plugin_interface_t
          * the whole output */
         if (!view->get_transformer(switcher_transformer))
         {
-            view->add_transformer(std::make_unique<wf::view_3D>(view),
-                switcher_transformer);
+            auto tr = std::make_unique<wf::view_3D>(view);
+            tr->use_thumbnail = true;
+            view->add_transformer(std::move(tr), switcher_transformer);
         }
 
         SwitcherView sw{duration};
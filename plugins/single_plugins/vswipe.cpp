@@ -104,6 +104,7 @@ class vswipe : public wf::plugin_interface_t
 
         wall = std::make_unique<wf::workspace_wall_t>(output);
         wall->connect_signal("frame", &this->on_frame);
+        wall->set_partial_repaint(true);
     }
 
     wf::signal_connection_t on_frame = {[=] (wf::signal_data_t*)
@@ -88,6 +88,7 @@ class tile_plugin_t : public wf::plugin_interface_t
     {
         auto output_geometry = output->get_relative_geometry();
         auto wsize = output->workspace->get_workspace_grid_size();
+        tile::layout_scope_t scope;
         for (int i = 0; i < wsize.width; i++)
         {
             for (int j = 0; j < wsize.height; j++)
@@ -111,6 +112,7 @@ class tile_plugin_t : public wf::plugin_interface_t
             .internal = inner_gaps,
         };
 
+        tile::layout_scope_t scope;
         for (auto& col : roots)
         {
             for (auto& root : col)
@@ -250,6 +252,7 @@ class tile_plugin_t : public wf::plugin_interface_t
         }
 
         auto view_node = std::make_unique<wf::tile::view_node_t>(view);
+        tile::layout_scope_t scope;
         roots[vp.x][vp.y]->as_split_node()->add_child(std::move(view_node));
         output->workspace->add_view_to_sublayer(view, tiled_sublayer[vp.x][vp.y]);
         output->workspace->bring_to_front(view); // bring that layer to the front
@@ -292,9 +295,12 @@ class tile_plugin_t : public wf::plugin_interface_t
         stop_controller(true);
         auto wview = view->view;
 
-        view->parent->remove_child(view);
-        /* View node is invalid now */
-        flatten_roots();
+        {
+            tile::layout_scope_t scope;
+            view->parent->remove_child(view);
+            /* View node is invalid now */
+            flatten_roots();
+        }
 
         if (wview->fullscreen && wview->is_mapped())
         {
@@ -305,6 +305,9 @@ void move_view_controller_t::input_released()
     auto split_type = (split == INSERT_LEFT || split == INSERT_RIGHT) ?
         SPLIT_VERTICAL : SPLIT_HORIZONTAL;
 
+    /* Show the views in their new places at once */
+    layout_scope_t scope;
+
     if (dropped_at->parent->get_split_direction() == split_type)
     {
         /* We can simply add the dragged view as a sibling of the target view */
@@ -45,6 +45,33 @@ wf::geometry_t get_output_local_coordinates(wf::output_t *output, wf::geometry_t
     return g;
 }
 
+/* ---------------------- layout_scope_t implementation --------------------- */
+static wf::layout_transaction_t *current_transaction = nullptr;
+
+layout_scope_t::layout_scope_t()
+{
+    if (!current_transaction)
+    {
+        transaction = std::make_unique<wf::layout_transaction_t>();
+        current_transaction = transaction.get();
+    }
+}
+
+layout_scope_t::~layout_scope_t()
+{
+    if (transaction)
+    {
+        /* Reset first, views may change the tree again while committing */
+        current_transaction = nullptr;
+        transaction->commit();
+    }
+}
+
+nonstd::observer_ptr<wf::layout_transaction_t> layout_scope_t::current()
+{
+    return nonstd::make_observer(current_transaction);
+}
+
 /* ---------------------- split_node_t implementation ----------------------- */
 wf::geometry_t split_node_t::get_child_geometry(
     int32_t child_pos, int32_t child_size)
@@ -385,7 +412,13 @@ void view_node_t::set_geometry(wf::geometry_t geometry)
     }
 
     view->set_tiled(TILED_EDGES_ALL);
-    view->set_geometry(calculate_target_geometry());
+    if (auto transaction = layout_scope_t::current())
+    {
+        transaction->set_geometry(view, calculate_target_geometry());
+    } else
+    {
+        view->set_geometry(calculate_target_geometry());
+    }
 }
 
 void view_node_t::update_transformer()
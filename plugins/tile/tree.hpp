@@ -2,6 +2,7 @@
 #define WF_TILE_PLUGIN_TREE
 
 #include <wayfire/view.hpp>
+#include <wayfire/layout-transaction.hpp>
 
 namespace wf
 {
@@ -173,6 +174,28 @@ struct view_node_t : public tree_node_t
     void update_transformer();
 };
 
+/**
+ * While a layout scope exists, the views in the tiling trees are not resized
+ * immediately when their nodes change. Instead, their new geometries are
+ * collected and committed as a single wf::layout_transaction_t when the scope
+ * is destroyed, so that the whole new layout is shown at once.
+ *
+ * Scopes may be nested, in which case only the outermost one commits.
+ */
+class layout_scope_t : public noncopyable_t
+{
+  public:
+    layout_scope_t();
+    ~layout_scope_t();
+
+    /** @return The transaction of the active scope, or nullptr if none */
+    static nonstd::observer_ptr<wf::layout_transaction_t> current();
+
+  private:
+    /* Set only for the outermost scope */
+    std::unique_ptr<wf::layout_transaction_t> transaction;
+};
+
 /**
  * Flatten the tree as much as possible, i.e remove nodes with only one
  * split-node child.
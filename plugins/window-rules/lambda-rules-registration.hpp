@@ -172,6 +172,7 @@ class lambda_rules_registrations_t : public custom_data_t
         }
 
         _registrations.emplace(key, registration);
+        ++_generation;
 
         return false;
     }
@@ -185,7 +186,10 @@ class lambda_rules_registrations_t : public custom_data_t
      */
     void unregister_lambda_rule(std::string key)
     {
-        _registrations.erase(key);
+        if (_registrations.erase(key))
+        {
+            ++_generation;
+        }
     }
 
     /**
@@ -211,6 +215,9 @@ class lambda_rules_registrations_t : public custom_data_t
      */
     map_type _registrations;
 
+    // Incremented whenever the set of registrations changes.
+    uint64_t _generation = 0;
+
     // Necessary for window-rules to manage the lifetime of the object
     uint32_t window_rule_instances = 0;
     friend class ::wayfire_window_rules_t;
@@ -0,0 +1,241 @@
+#ifndef RULE_INDEX_HPP
+#define RULE_INDEX_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "wayfire/view.hpp"
+
+namespace wf
+{
+/**
+ * What can be told about a rule from its text, without evaluating it.
+ */
+struct rule_summary_t
+{
+    /** The signal the rule reacts to, or empty if it is not known. */
+    std::string signal;
+
+    /**
+     * A property ("app_id" or "title") and the value which a view must have
+     * for the rule to do anything, or empty if there is no such requirement.
+     */
+    std::string property;
+    std::string value;
+};
+
+/**
+ * Summarize a rule of the form "on <signal> if <condition> [then ...]".
+ *
+ * A property requirement is found only if the condition is a conjunction,
+ * i.e it has no |, ! or else, and it contains a test like app_id is "value".
+ */
+inline rule_summary_t summarize_rule(const std::string & rule)
+{
+    struct token_t
+    {
+        std::string text;
+        bool quoted;
+    };
+
+    std::vector<token_t> tokens;
+    const std::string punctuation = "()&|!";
+    size_t i = 0;
+    while (i < rule.size())
+    {
+        if (std::isspace((unsigned char)rule[i]))
+        {
+            ++i;
+        } else if (rule[i] == '"')
+        {
+            std::string text;
+            for (++i; i < rule.size() && rule[i] != '"'; ++i)
+            {
+                if ((rule[i] == '\\') && (i + 1 < rule.size()))
+                {
+                    ++i;
+                }
+
+                text += rule[i];
+            }
+
+            tokens.push_back({text, true});
+            ++i;
+        } else if (punctuation.find(rule[i]) != std::string::npos)
+        {
+            tokens.push_back({std::string(1, rule[i]), false});
+            ++i;
+        } else
+        {
+            size_t end = i;
+            while (end < rule.size() && !std::isspace((unsigned char)rule[end]) &&
+                   (punctuation.find(rule[end]) == std::string::npos) &&
+                   (rule[end] != '"'))
+            {
+                ++end;
+            }
+
+            tokens.push_back({rule.substr(i, end - i), false});
+            i = end;
+        }
+    }
+
+    rule_summary_t summary;
+    if ((tokens.size() < 2) || tokens[0].quoted || (tokens[0].text != "on"))
+    {
+        return summary;
+    }
+
+    summary.signal = tokens[1].text;
+
+    /* Find the condition, which runs until "then" (or the end for lambda
+     * rules), and make sure nothing runs when it is false */
+    size_t cond_begin = tokens.size(), cond_end = tokens.size();
+    for (size_t t = 2; t < tokens.size(); t++)
+    {
+        if (tokens[t].quoted)
+        {
+            continue;
+        }
+
+        auto& text = tokens[t].text;
+        if ((text == "|") || (text == "!") || (text == "else") ||
+            (text == "or") || (text == "not"))
+        {
+            return summary;
+        }
+
+        if ((text == "if") && (cond_begin == tokens.size()))
+        {
+            cond_begin = t + 1;
+        } else if ((text == "then") && (cond_end == tokens.size()))
+        {
+            cond_end = t;
+        }
+    }
+
+    for (size_t t = cond_begin; t + 2 < cond_end; t++)
+    {
+        auto& name    = tokens[t];
+        auto& op      = tokens[t + 1];
+        auto& literal = tokens[t + 2];
+        bool is_equality = !op.quoted &&
+            ((op.text == "is") || (op.text == "equals"));
+        if (name.quoted || !is_equality || !literal.quoted ||
+            ((name.text != "app_id") && (name.text != "title")))
+        {
+            continue;
+        }
+
+        /* app_id doesn't change as often as the title, prefer it */
+        if (summary.property.empty() || (name.text == "app_id"))
+        {
+            summary.property = name.text;
+            summary.value    = literal.text;
+        }
+    }
+
+    return summary;
+}
+
+/**
+ * An index over a list of rules, which finds the rules that can possibly do
+ * something for a given signal and view. Rules are identified by their
+ * position in the list.
+ */
+class rule_index_t
+{
+  public:
+    void clear()
+    {
+        by_signal.clear();
+        any_signal = {};
+    }
+
+    /**
+     * Add the rule at the given position in the list.
+     *
+     * @param use_property Whether the rule can be skipped for views which
+     *   don't have the property value it requires. This is not the case if
+     *   the rule does something when its condition is false.
+     */
+    void add(size_t position, const std::string & rule, bool use_property = true)
+    {
+        auto summary = summarize_rule(rule);
+        if (!use_property)
+        {
+            summary.property.clear();
+        }
+
+        auto& entry  = summary.signal.empty() ? any_signal :
+            by_signal[summary.signal];
+
+        if (summary.property == "app_id")
+        {
+            entry.by_app_id[summary.value].push_back(position);
+        } else if (summary.property == "title")
+        {
+            entry.by_title[summary.value].push_back(position);
+        } else
+        {
+            entry.always.push_back(position);
+        }
+    }
+
+    /** @return The positions of the candidate rules, in ascending order. */
+    std::vector<size_t> find(const std::string & signal, wayfire_view view) const
+    {
+        std::vector<size_t> result;
+        collect(any_signal, view, result);
+
+        auto it = by_signal.find(signal);
+        if (it != by_signal.end())
+        {
+            collect(it->second, view, result);
+        }
+
+        std::sort(result.begin(), result.end());
+
+        return result;
+    }
+
+  private:
+    struct entry_t
+    {
+        std::vector<size_t> always;
+        std::unordered_map<std::string, std::vector<size_t>> by_app_id;
+        std::unordered_map<std::string, std::vector<size_t>> by_title;
+    };
+
+    std::unordered_map<std::string, entry_t> by_signal;
+    entry_t any_signal;
+
+    static void collect(const entry_t & entry, wayfire_view view,
+        std::vector<size_t> & result)
+    {
+        result.insert(result.end(), entry.always.begin(), entry.always.end());
+        if (!entry.by_app_id.empty())
+        {
+            auto it = entry.by_app_id.find(view->get_app_id());
+            if (it != entry.by_app_id.end())
+            {
+                result.insert(result.end(), it->second.begin(), it->second.end());
+            }
+        }
+
+        if (!entry.by_title.empty())
+        {
+            auto it = entry.by_title.find(view->get_title());
+            if (it != entry.by_title.end())
+            {
+                result.insert(result.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+};
+} // End namespace wf.
+
+#endif // RULE_INDEX_HPP
@@ -17,6 +17,7 @@
 
 #include "lambda-rules-registration.hpp"
 #include "view-action-interface.hpp"
+#include "rule-index.hpp"
 
 class wayfire_window_rules_t : public wf::plugin_interface_t
 {
@@ -66,6 +67,14 @@ class wayfire_window_rules_t : public wf::plugin_interface_t
     };
 
     std::vector<std::shared_ptr<wf::rule_t>> _rules;
+    wf::rule_index_t _rules_index;
+
+    // The lambda registrations in order, indexed like the rules from the config.
+    // Rebuilt when the registrations change.
+    void update_lambda_index();
+    std::vector<std::shared_ptr<wf::lambda_rule_registration_t>> _lambda_rules;
+    wf::rule_index_t _lambda_index;
+    uint64_t _lambda_generation = -1;
 
     wf::view_access_interface_t _access_interface;
     wf::view_action_interface_t _action_interface;
@@ -124,8 +133,10 @@ void wayfire_window_rules_t::apply(const std::string & signal,
         return;
     }
 
-    for (const auto & rule : _rules)
+    // Only the rules which can match the signal and the view are evaluated.
+    for (auto position : _rules_index.find(signal, view))
     {
+        const auto & rule = _rules[position];
         _access_interface.set_view(view);
         _action_interface.set_view(view);
         auto error = rule->apply(signal, _access_interface, _action_interface);
@@ -135,12 +146,10 @@ void wayfire_window_rules_t::apply(const std::string & signal,
         }
     }
 
-    auto bounds = _lambda_registrations->rules();
-    auto begin  = std::get<0>(bounds);
-    auto end    = std::get<1>(bounds);
-    while (begin != end)
+    update_lambda_index();
+    for (auto position : _lambda_index.find(signal, view))
     {
-        auto registration = std::get<1>(*begin);
+        auto registration = _lambda_rules[position];
         bool error = false;
 
         // Assume we will use the view access interface.
@@ -185,14 +194,38 @@ void wayfire_window_rules_t::apply(const std::string & signal,
             LOGE("Window-rules: Error while executing rule on signal: ", signal,
                 ", rule text:", registration->rule);
         }
+    }
+}
+
+void wayfire_window_rules_t::update_lambda_index()
+{
+    if (_lambda_generation == _lambda_registrations->_generation)
+    {
+        return;
+    }
 
-        ++begin;
+    _lambda_generation = _lambda_registrations->_generation;
+    _lambda_rules.clear();
+    _lambda_index.clear();
+
+    auto bounds = _lambda_registrations->rules();
+    for (auto it = std::get<0>(bounds); it != std::get<1>(bounds); ++it)
+    {
+        auto registration = std::get<1>(*it);
+
+        // Rules with an else lambda or a custom access interface don't depend
+        // only on the view's properties.
+        bool use_property = !registration->else_lambda &&
+            !registration->access_interface;
+        _lambda_index.add(_lambda_rules.size(), registration->rule, use_property);
+        _lambda_rules.push_back(registration);
     }
 }
 
 void wayfire_window_rules_t::setup_rules_from_config()
 {
     _rules.clear();
+    _rules_index.clear();
 
     // Build rule list.
     auto section = wf::get_core().config.get_section("window-rules");
@@ -202,6 +235,7 @@ void wayfire_window_rules_t::setup_rules_from_config()
         auto rule = wf::rule_parser_t().parse(_lexer);
         if (rule != nullptr)
         {
+            _rules_index.add(_rules.size(), opt->get_value_str());
             _rules.push_back(rule);
         }
     }
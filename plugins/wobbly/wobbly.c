@@ -39,45 +39,42 @@
 
 #define GRID_WIDTH  4
 #define GRID_HEIGHT 4
+#define GRID_SIZE   (GRID_WIDTH * GRID_HEIGHT)
 
-#define MODEL_MAX_SPRINGS (GRID_WIDTH * GRID_HEIGHT * 2)
+#if GRID_SIZE != WOBBLY_CONTROL_POINTS
+#error "The grid size must match the number of control points"
+#endif
+
+/* The object arrays are padded with one extra row, so that the spring kernel
+ * can read the right and bottom neighbour of every object without bounds
+ * checks. The padding objects never receive any forces. */
+#define GRID_PADDED_SIZE (GRID_SIZE + GRID_WIDTH)
 
 typedef struct _xy_pair {
     float x, y;
 } Point, Vector;
 
-typedef struct _Edge {
-    float next, prev;
-
-    float start;
-    float end;
-
-    float attract;
-    float velocity;
-} Edge;
-
-typedef struct _Object {
-    Vector	 force;
-    Point	 position;
-    Vector	 velocity;
-    float	 theta;
-    int		 immobile;
-    Edge	 vertEdge;
-    Edge	 horzEdge;
-} Object;
-
-typedef struct _Spring {
-    Object *a;
-    Object *b;
-    Vector offset;
-} Spring;
-
+/*
+ * The objects of the model are stored as a structure of arrays, so that the
+ * spring and object kernels below operate on whole arrays and can be
+ * vectorized by the compiler.
+ *
+ * The springs are not stored explicitly: every object is connected with a
+ * spring to its right and to its bottom neighbour in the grid. All horizontal
+ * springs have the rest length hpad, and all vertical springs have vpad.
+ */
 typedef struct _Model {
-    Object	 *objects;
-    int		 numObjects;
-    Spring	 springs[MODEL_MAX_SPRINGS];
-    int		 numSprings;
-    Object	 *anchorObject;
+    float	 positionX[GRID_PADDED_SIZE];
+    float	 positionY[GRID_PADDED_SIZE];
+    float	 velocityX[GRID_SIZE];
+    float	 velocityY[GRID_SIZE];
+    float	 forceX[GRID_SIZE];
+    float	 forceY[GRID_SIZE];
+    /* 1.0 for objects which can move, 0.0 for immobile ones */
+    float	 mobile[GRID_SIZE];
+    /* index of the anchor object, or -1 if there is none */
+    int		 anchorObject;
+    float	 hpad, vpad;
     float	 steps;
     Point	 topLeft;
     Point	 bottomRight;
@@ -97,32 +94,50 @@ typedef struct _WobblyWindow {
 #define WobblyForce    (1L << 1)
 #define WobblyVelocity (1L << 2)
 
-static void objectInit(Object *object, float positionX, float positionY,
-        float velocityX, float velocityY)
+/* springMaskH[i] is 1.0 if object i has a right neighbour, springMaskV[i] is
+ * 1.0 if it has a bottom neighbour */
+static float springMaskH[GRID_SIZE];
+static float springMaskV[GRID_SIZE];
+
+static void springMasksInit(void)
 {
-    object->force.x = 0;
-    object->force.y = 0;
+    static int initialized = 0;
+    int i;
 
-    object->position.x = positionX;
-    object->position.y = positionY;
+    if (initialized)
+        return;
 
-    object->velocity.x = velocityX;
-    object->velocity.y = velocityY;
+    for (i = 0; i < GRID_SIZE; i++)
+    {
+        springMaskH[i] = (i % GRID_WIDTH) < GRID_WIDTH - 1;
+        springMaskV[i] = i < GRID_SIZE - GRID_WIDTH;
+    }
+
+    initialized = 1;
+}
+
+static void objectInit(Model *model, int i, float positionX, float positionY)
+{
+    model->forceX[i] = 0;
+    model->forceY[i] = 0;
+
+    model->positionX[i] = positionX;
+    model->positionY[i] = positionY;
 
-    object->theta    = 0;
-    object->immobile = 0;
+    model->velocityX[i] = 0;
+    model->velocityY[i] = 0;
 
-    object->vertEdge.next = 0.0f;
-    object->horzEdge.next = 0.0f;
+    model->mobile[i] = 1.0f;
+}
+
+static int objectIsImmobile(Model *model, int i)
+{
+    return model->mobile[i] == 0.0f;
 }
 
-static void springInit(Spring *spring, Object *a, Object *b,
-	    float offsetX, float offsetY)
+static void objectSetImmobile(Model *model, int i, int immobile)
 {
-    spring->a	     = a;
-    spring->b	     = b;
-    spring->offset.x = offsetX;
-    spring->offset.y = offsetY;
+    model->mobile[i] = immobile ? 0.0f : 1.0f;
 }
 
 static void modelCalcBounds(Model *model)
@@ -134,65 +149,52 @@ static void modelCalcBounds(Model *model)
     model->bottomRight.x = SHRT_MIN;
     model->bottomRight.y = SHRT_MIN;
 
-    for (i = 0; i < model->numObjects; i++)
+    for (i = 0; i < GRID_SIZE; i++)
     {
-        if (model->objects[i].position.x < model->topLeft.x)
-            model->topLeft.x = model->objects[i].position.x;
-        else if (model->objects[i].position.x > model->bottomRight.x)
-            model->bottomRight.x = model->objects[i].position.x;
-
-        if (model->objects[i].position.y < model->topLeft.y)
-            model->topLeft.y = model->objects[i].position.y;
-        else if (model->objects[i].position.y > model->bottomRight.y)
-            model->bottomRight.y = model->objects[i].position.y;
+        model->topLeft.x = fminf(model->topLeft.x, model->positionX[i]);
+        model->topLeft.y = fminf(model->topLeft.y, model->positionY[i]);
+        model->bottomRight.x = fmaxf(model->bottomRight.x, model->positionX[i]);
+        model->bottomRight.y = fmaxf(model->bottomRight.y, model->positionY[i]);
     }
 }
 
-static void modelAddSpring(Model *model, Object *a, Object *b,
-		float offsetX, float offsetY)
+static void modelSetAnchor(Model *model, int i)
 {
-    Spring *spring;
+    if (model->anchorObject >= 0)
+        objectSetImmobile(model, model->anchorObject, 0);
 
-    spring = &model->springs[model->numSprings];
-    model->numSprings++;
-
-    springInit (spring, a, b, offsetX, offsetY);
+    model->anchorObject = i;
+    if (i >= 0)
+        objectSetImmobile(model, i, 1);
 }
 
 static void modelSetMiddleAnchor(Model *model, int x, int y,
         int width, int height)
 {
     float gx, gy;
+    int anchor;
 
     gx = ((GRID_WIDTH  - 1) / 2 * width)  / (float) (GRID_WIDTH  - 1);
     gy = ((GRID_HEIGHT - 1) / 2 * height) / (float) (GRID_HEIGHT - 1);
 
-    if (model->anchorObject)
-        model->anchorObject->immobile = 0;
-
-    model->anchorObject =
-        &model->objects[GRID_WIDTH * ((GRID_HEIGHT-1)/2) + (GRID_WIDTH-1)/ 2];
-    model->anchorObject->position.x = x + gx;
-    model->anchorObject->position.y = y + gy;
-
-    model->anchorObject->immobile = 1;
+    anchor = GRID_WIDTH * ((GRID_HEIGHT-1)/2) + (GRID_WIDTH-1)/ 2;
+    modelSetAnchor(model, anchor);
+    model->positionX[anchor] = x + gx;
+    model->positionY[anchor] = y + gy;
 }
 
 static void modelSetTopAnchor(Model *model, int x, int y,
         int width)
 {
     float gx;
+    int anchor;
 
     gx = ((GRID_WIDTH  - 1) / 2 * width)  / (float) (GRID_WIDTH  - 1);
 
-    if (model->anchorObject)
-	model->anchorObject->immobile = 0;
-
-    model->anchorObject = &model->objects[(GRID_WIDTH-1)/ 2];
-    model->anchorObject->position.x = x + gx;
-    model->anchorObject->position.y = y;
-
-    model->anchorObject->immobile = 1;
+    anchor = (GRID_WIDTH-1)/ 2;
+    modelSetAnchor(model, anchor);
+    model->positionX[anchor] = x + gx;
+    model->positionY[anchor] = y;
 }
 
 static void modelInitObjects(Model *model, int x, int y, int width, int height)
@@ -207,67 +209,40 @@ static void modelInitObjects(Model *model, int x, int y, int width, int height)
     {
         for (gridX = 0; gridX < GRID_WIDTH; gridX++)
         {
-            objectInit (&model->objects[i],
+            objectInit (model, i,
                     x + (gridX * width) / gw,
-                    y + (gridY * height) / gh,
-                    0, 0);
+                    y + (gridY * height) / gh);
             i++;
         }
     }
 
-    if (!model->anchorObject)
+    for (i = GRID_SIZE; i < GRID_PADDED_SIZE; i++)
+    {
+        model->positionX[i] = 0;
+        model->positionY[i] = 0;
+    }
+
+    if (model->anchorObject < 0)
         modelSetMiddleAnchor (model, x, y, width, height);
 }
 
 static void modelInitSprings(Model *model, int width, int height)
 {
-    int   gridX, gridY, i = 0;
-    float hpad, vpad;
-
-    model->numSprings = 0;
-
-    hpad = ((float) width) / (GRID_WIDTH  - 1);
-    vpad = ((float) height) / (GRID_HEIGHT - 1);
-
-    for (gridY = 0; gridY < GRID_HEIGHT; gridY++)
-    {
-        for (gridX = 0; gridX < GRID_WIDTH; gridX++)
-        {
-            if (gridX > 0)
-            {
-                modelAddSpring (model, &model->objects[i - 1],
-                        &model->objects[i], hpad, 0);
-            }
-
-            if (gridY > 0)
-            {
-                modelAddSpring (model, &model->objects[i - GRID_WIDTH],
-                        &model->objects[i], 0, vpad);
-            }
-
-            i++;
-        }
-    }
+    model->hpad = ((float) width) / (GRID_WIDTH  - 1);
+    model->vpad = ((float) height) / (GRID_HEIGHT - 1);
 }
 
 static Model * createModel(int x, int y, int width, int height)
 {
     Model *model;
 
+    springMasksInit();
+
     model = malloc(sizeof(Model));
     if (!model)
         return 0;
 
-    model->numObjects = GRID_WIDTH * GRID_HEIGHT;
-    model->objects = malloc (sizeof (Object) * model->numObjects);
-    if (!model->objects)
-    {
-        free (model);
-        return 0;
-    }
-
-    model->anchorObject = 0;
-    model->numSprings = 0;
+    model->anchorObject = -1;
     model->steps = 0;
 
     modelInitObjects (model, x, y, width, height);
@@ -277,131 +252,144 @@ static Model * createModel(int x, int y, int width, int height)
     return model;
 }
 
-static void objectApplyForce(Object *object, float fx, float fy)
-{
-    object->force.x += fx;
-    object->force.y += fy;
-}
-
-static void springExertForces(Spring *spring, float k)
+/*
+ * Add the forces of all springs to the objects.
+ *
+ * springH[GRID_WIDTH + i] is the force of the spring between object i and
+ * its right neighbour, springV[GRID_WIDTH + i] the force of the spring
+ * between object i and its bottom neighbour. The first GRID_WIDTH entries
+ * stay zero, so that the force of the spring to the left and top neighbour
+ * can be read without bounds checks.
+ */
+static void modelExertSpringForces(Model *model, float k)
 {
-    Vector da, db;
-    Vector a, b;
-
-    a = spring->a->position;
-    b = spring->b->position;
+    float springHX[GRID_PADDED_SIZE], springHY[GRID_PADDED_SIZE];
+    float springVX[GRID_PADDED_SIZE], springVY[GRID_PADDED_SIZE];
+    const float *px = model->positionX, *py = model->positionY;
+    float hk = 0.5f * k;
+    int i;
 
-    da.x = 0.5f * (b.x - a.x - spring->offset.x);
-    da.y = 0.5f * (b.y - a.y - spring->offset.y);
+    for (i = 0; i < GRID_WIDTH; i++)
+    {
+        springHX[i] = springHY[i] = 0.0f;
+        springVX[i] = springVY[i] = 0.0f;
+    }
 
-    db.x = 0.5f * (a.x - b.x + spring->offset.x);
-    db.y = 0.5f * (a.y - b.y + spring->offset.y);
+    for (i = 0; i < GRID_SIZE; i++)
+    {
+        springHX[GRID_WIDTH + i] = springMaskH[i] * hk *
+            (px[i + 1] - px[i] - model->hpad);
+        springHY[GRID_WIDTH + i] = springMaskH[i] * hk *
+            (py[i + 1] - py[i]);
+
+        springVX[GRID_WIDTH + i] = springMaskV[i] * hk *
+            (px[i + GRID_WIDTH] - px[i]);
+        springVY[GRID_WIDTH + i] = springMaskV[i] * hk *
+            (py[i + GRID_WIDTH] - py[i] - model->vpad);
+    }
 
-    objectApplyForce (spring->a, k * da.x, k * da.y);
-    objectApplyForce (spring->b, k * db.x, k * db.y);
+    for (i = 0; i < GRID_SIZE; i++)
+    {
+        model->forceX[i] += springHX[GRID_WIDTH + i] - springHX[GRID_WIDTH + i - 1]
+            + springVX[GRID_WIDTH + i] - springVX[i];
+        model->forceY[i] += springHY[GRID_WIDTH + i] - springHY[GRID_WIDTH + i - 1]
+            + springVY[GRID_WIDTH + i] - springVY[i];
+    }
 }
 
-static float modelStepObject(Object *object, float friction, float *force)
+/*
+ * Move all objects according to the forces acting on them. Immobile objects
+ * are handled with the mobile mask instead of a branch, and the absolute
+ * forces and velocities are accumulated per object, so that the loop can be
+ * vectorized. Their totals are added to forceSum and velocitySum.
+ */
+static void modelStepObjects(Model *model, float friction,
+        float *forceSum, float *velocitySum)
 {
-    object->theta += 0.05f;
+    float objectForce[GRID_SIZE], objectVelocity[GRID_SIZE];
+    float fx, fy;
+    int i;
 
-    if (object->immobile)
+    for (i = 0; i < GRID_SIZE; i++)
     {
-        object->velocity.x = 0.0f;
-        object->velocity.y = 0.0f;
-        object->force.x = 0.0f;
-        object->force.y = 0.0f;
+        fx = (model->forceX[i] - friction * model->velocityX[i]) * model->mobile[i];
+        fy = (model->forceY[i] - friction * model->velocityY[i]) * model->mobile[i];
 
-        *force = 0.0f;
-        return 0.0f;
-    }
-    else
-    {
-        object->force.x -= friction * object->velocity.x;
-        object->force.y -= friction * object->velocity.y;
+        model->velocityX[i] = (model->velocityX[i] + fx / WOBBLY_MASS) * model->mobile[i];
+        model->velocityY[i] = (model->velocityY[i] + fy / WOBBLY_MASS) * model->mobile[i];
 
-        object->velocity.x += object->force.x / WOBBLY_MASS;
-        object->velocity.y += object->force.y / WOBBLY_MASS;
+        model->positionX[i] += model->velocityX[i];
+        model->positionY[i] += model->velocityY[i];
 
-        object->position.x += object->velocity.x;
-        object->position.y += object->velocity.y;
+        objectForce[i] = fabsf(fx) + fabsf(fy);
+        objectVelocity[i] = fabsf(model->velocityX[i]) + fabsf(model->velocityY[i]);
 
-        *force = fabs(object->force.x) + fabs(object->force.y);
-
-        object->force.x = 0.0f;
-        object->force.y = 0.0f;
+        model->forceX[i] = 0.0f;
+        model->forceY[i] = 0.0f;
+    }
 
-        return fabs(object->velocity.x) + fabs(object->velocity.y);
+    for (i = 0; i < GRID_SIZE; i++)
+    {
+        *forceSum += objectForce[i];
+        *velocitySum += objectVelocity[i];
     }
 }
 
-static int modelStep(Model *model, float friction, float k, float time)
+#define MODEL_BATCH_SIZE 32
+
+/*
+ * Step up to MODEL_BATCH_SIZE models at once. time[m] is the time elapsed
+ * for models[m], and the resulting wobbly flags are stored in result[m].
+ *
+ * All models advance their simulation one step after another together, so
+ * that the kernels run back to back over small, cache-resident arrays.
+ */
+static void modelStepBatch(Model **models, const float *time, int count,
+        float friction, float k, int *result)
 {
-    int   i, j, steps, wobbly = 0;
-    float velocitySum = 0.0f;
-    float force, forceSum = 0.0f;
+    float forceSum[MODEL_BATCH_SIZE], velocitySum[MODEL_BATCH_SIZE];
+    int   steps[MODEL_BATCH_SIZE];
+    int   j, m, maxSteps = 0;
 
-    model->steps += time / 15.0f;
-    steps = floor (model->steps);
-    model->steps -= steps;
+    for (m = 0; m < count; m++)
+    {
+        models[m]->steps += time[m] / 15.0f;
+        steps[m] = floor (models[m]->steps);
+        models[m]->steps -= steps[m];
 
-    if (!steps)
-        return 1;
+        forceSum[m] = velocitySum[m] = 0.0f;
+        if (steps[m] > maxSteps)
+            maxSteps = steps[m];
+    }
 
-    for (j = 0; j < steps; j++)
+    for (j = 0; j < maxSteps; j++)
     {
-        for (i = 0; i < model->numSprings; i++)
-            springExertForces (&model->springs[i], k);
-
-        for (i = 0; i < model->numObjects; i++)
+        for (m = 0; m < count; m++)
         {
-            velocitySum += modelStepObject(&model->objects[i], friction, &force);
-            forceSum += force;
+            if (j < steps[m])
+            {
+                modelExertSpringForces (models[m], k);
+                modelStepObjects (models[m], friction,
+                        &forceSum[m], &velocitySum[m]);
+            }
         }
     }
 
-    modelCalcBounds (model);
-
-    if (velocitySum > 0.5f)
-        wobbly |= WobblyVelocity;
-    if (forceSum > 20.0f)
-        wobbly |= WobblyForce;
-
-    return wobbly;
-}
-
-static void bezierPatchEvaluate (Model *model, float u, float v,
-        float *patchX, float *patchY)
-{
-    float coeffsU[4], coeffsV[4];
-    float x, y;
-    int   i, j;
-
-    coeffsU[0] = (1 - u) * (1 - u) * (1 - u);
-    coeffsU[1] = 3 * u * (1 - u) * (1 - u);
-    coeffsU[2] = 3 * u * u * (1 - u);
-    coeffsU[3] = u * u * u;
-
-    coeffsV[0] = (1 - v) * (1 - v) * (1 - v);
-    coeffsV[1] = 3 * v * (1 - v) * (1 - v);
-    coeffsV[2] = 3 * v * v * (1 - v);
-    coeffsV[3] = v * v * v;
-
-    x = y = 0.0f;
-
-    for (i = 0; i < 4; i++)
+    for (m = 0; m < count; m++)
     {
-        for (j = 0; j < 4; j++)
+        modelCalcBounds (models[m]);
+        if (!steps[m])
         {
-            x += coeffsU[i] * coeffsV[j] *
-                model->objects[j * GRID_WIDTH + i].position.x;
-            y += coeffsU[i] * coeffsV[j] *
-                model->objects[j * GRID_HEIGHT + i].position.y;
+            result[m] = 1;
+            continue;
         }
-    }
 
-    *patchX = x;
-    *patchY = y;
+        result[m] = 0;
+        if (velocitySum[m] > 0.5f)
+            result[m] |= WobblyVelocity;
+        if (forceSum[m] > 20.0f)
+            result[m] |= WobblyForce;
+    }
 }
 
 static int wobblyEnsureModel(struct wobbly_surface *surface)
@@ -419,123 +407,155 @@ static int wobblyEnsureModel(struct wobbly_surface *surface)
     return 1;
 }
 
-static float objectDistance(Object *object, float x, float y)
+static float objectDistance(Model *model, int i, float x, float y)
 {
     float dx, dy;
-    dx = object->position.x - x;
-    dy = object->position.y - y;
+    dx = model->positionX[i] - x;
+    dy = model->positionY[i] - y;
 
     return sqrt(dx * dx + dy * dy);
 }
 
-static Object *modelFindNearestObject(Model *model, float x, float y)
+static int modelFindNearestObject(Model *model, float x, float y)
 {
-    Object *object = &model->objects[0];
+    int    object = 0;
     float  distance, minDistance = 0.0;
     int    i;
 
-    for (i = 0; i < model->numObjects; i++)
+    for (i = 0; i < GRID_SIZE; i++)
     {
-        distance = objectDistance(&model->objects[i], x, y);
+        distance = objectDistance(model, i, x, y);
         if (i == 0 || distance < minDistance)
         {
             minDistance = distance;
-            object = &model->objects[i];
+            object = i;
         }
     }
 
     return object;
 }
 
+/* Push the neighbours of the given object away from it, as if it had been
+ * hit, which starts the wobbling. */
+static void modelPushNeighbours(Model *model, int i)
+{
+    int gridX = i % GRID_WIDTH;
+
+    if (gridX < GRID_WIDTH - 1)
+        model->velocityX[i + 1] -= model->hpad * 0.05f;
+    if (gridX > 0)
+        model->velocityX[i - 1] += model->hpad * 0.05f;
+    if (i + GRID_WIDTH < GRID_SIZE)
+        model->velocityY[i + GRID_WIDTH] -= model->vpad * 0.05f;
+    if (i - GRID_WIDTH >= 0)
+        model->velocityY[i - GRID_WIDTH] += model->vpad * 0.05f;
+}
+
 static void modelAdjustCorners(Model *model, int x, int y,
         int width, int height, int make_immobile)
 {
-    Object *o;
-    o = &model->objects[0];
-    o->position.x = x;
-    o->position.y = y;
-    o->immobile = make_immobile;
+    int o;
+    o = 0;
+    model->positionX[o] = x;
+    model->positionY[o] = y;
+    objectSetImmobile(model, o, make_immobile);
 
-    o = &model->objects[GRID_WIDTH - 1];
-    o->position.x = x + width;
-    o->position.y = y;
-    o->immobile = make_immobile;
+    o = GRID_WIDTH - 1;
+    model->positionX[o] = x + width;
+    model->positionY[o] = y;
+    objectSetImmobile(model, o, make_immobile);
 
-    o = &model->objects[GRID_WIDTH * (GRID_HEIGHT - 1)];
-    o->position.x = x;
-    o->position.y = y + height;
-    o->immobile = make_immobile;
+    o = GRID_WIDTH * (GRID_HEIGHT - 1);
+    model->positionX[o] = x;
+    model->positionY[o] = y + height;
+    objectSetImmobile(model, o, make_immobile);
 
-    o = &model->objects[model->numObjects - 1];
-    o->position.x = x + width;
-    o->position.y = y + height;
-    o->immobile = make_immobile;
+    o = GRID_SIZE - 1;
+    model->positionX[o] = x + width;
+    model->positionY[o] = y + height;
+    objectSetImmobile(model, o, make_immobile);
 
-    if (!model->anchorObject)
-        model->anchorObject = &model->objects[0];
+    if (model->anchorObject < 0)
+        model->anchorObject = 0;
 }
 
 static int modelRemoveEdgeAnchors(Model *model)
 {
+    static const int corners[] = {
+        0, GRID_WIDTH - 1, GRID_WIDTH * (GRID_HEIGHT - 1), GRID_SIZE - 1,
+    };
+
     int result = 0;
-    Object *o;
+    int i;
 
-    o = &model->objects[0];
-    if (o != model->anchorObject)
+    for (i = 0; i < 4; i++)
     {
-        result |= o->immobile;
-        o->immobile = 0;
+        if (corners[i] != model->anchorObject)
+        {
+            result |= objectIsImmobile(model, corners[i]);
+            objectSetImmobile(model, corners[i], 0);
+        }
     }
 
-    o = &model->objects[GRID_WIDTH - 1];
-    if (o != model->anchorObject)
-    {
-        result |= o->immobile;
-        o->immobile = 0;
-    }
+    return result;
+}
 
-    o = &model->objects[GRID_WIDTH * (GRID_HEIGHT - 1)];
-    if (o != model->anchorObject)
-    {
-        result |= o->immobile;
-        o->immobile = 0;
-    }
+static void wobblyStepBatch(struct wobbly_surface **surfaces,
+        const float *time, int count)
+{
+    Model *models[MODEL_BATCH_SIZE];
+    int result[MODEL_BATCH_SIZE];
+    int i;
 
-    o = &model->objects[model->numObjects - 1];
-    if (o != model->anchorObject)
+    for (i = 0; i < count; i++)
+        models[i] = ((WobblyWindow*)surfaces[i]->ww)->model;
+
+    modelStepBatch(models, time, count, wobbly_settings_get_friction(),
+            wobbly_settings_get_spring_k(), result);
+
+    for (i = 0; i < count; i++)
     {
-        result |= o->immobile;
-        o->immobile = 0;
-    }
+        WobblyWindow *ww = surfaces[i]->ww;
 
-    return result;
+        ww->wobbly = result[i];
+        if (!ww->wobbly)
+        {
+            surfaces[i]->x = ww->model->topLeft.x;
+            surfaces[i]->y = ww->model->topLeft.y;
+            surfaces[i]->synced = 1;
+        }
+    }
 }
 
-void wobbly_prepare_paint(struct wobbly_surface *surface, int msSinceLastPaint)
+void wobbly_prepare_paint_batch(struct wobbly_surface **surfaces,
+        const int *msSinceLastPaint, int count)
 {
-    WobblyWindow *ww = surface->ww;
-    float  friction, springK;
-
-    friction = wobbly_settings_get_friction();
-    springK  = wobbly_settings_get_spring_k();
+    struct wobbly_surface *batch[MODEL_BATCH_SIZE];
+    float time[MODEL_BATCH_SIZE];
+    int i, n = 0;
 
-    if (ww->wobbly)
+    for (i = 0; i < count; i++)
     {
-        if (ww->wobbly & (WobblyInitial | WobblyVelocity | WobblyForce))
+        WobblyWindow *ww = surfaces[i]->ww;
+        if (!(ww->wobbly & (WobblyInitial | WobblyVelocity | WobblyForce)))
+            continue;
+
+        batch[n] = surfaces[i];
+        time[n] = (ww->wobbly & WobblyVelocity) ? msSinceLastPaint[i] : 16;
+        if (++n == MODEL_BATCH_SIZE)
         {
-            ww->wobbly = modelStep(ww->model, friction, springK,
-                    (ww->wobbly & WobblyVelocity) ?
-                    msSinceLastPaint : 16);
-
-            if (ww->wobbly) {
-                modelCalcBounds(ww->model);
-            } else {
-                surface->x = ww->model->topLeft.x;
-                surface->y = ww->model->topLeft.y;
-                surface->synced = 1;
-            }
+            wobblyStepBatch(batch, time, n);
+            n = 0;
         }
     }
+
+    if (n > 0)
+        wobblyStepBatch(batch, time, n);
+}
+
+void wobbly_prepare_paint(struct wobbly_surface *surface, int msSinceLastPaint)
+{
+    wobbly_prepare_paint_batch(&surface, &msSinceLastPaint, 1);
 }
 
 void wobbly_done_paint(struct wobbly_surface *surface)
@@ -548,48 +568,15 @@ void wobbly_done_paint(struct wobbly_surface *surface)
     }
 }
 
-void wobbly_add_geometry(struct wobbly_surface *surface)
+void wobbly_get_control_points(struct wobbly_surface *surface, float *points)
 {
     WobblyWindow *ww = surface->ww;
+    int i;
 
-    float    width, height;
-    float    deformedX, deformedY;
-    int      x, y, iw, ih;
-    float    cell_w, cell_h;
-    GLfloat  *v, *uv;
-
-    if (ww->wobbly)
+    for (i = 0; i < GRID_SIZE; i++)
     {
-        width  = surface->width;
-        height = surface->height;
-
-        cell_w = width / surface->x_cells;
-        cell_h = height / surface->y_cells;
-
-        iw = surface->x_cells + 1;
-        ih = surface->y_cells + 1;
-
-        v = realloc(surface->v, sizeof(GLfloat) * 2 * iw * ih);
-        uv = realloc(surface->uv, sizeof(GLfloat) * 2 * iw * ih);
-
-        surface->v = v;
-        surface->uv = uv;
-
-        for (y = 0; y < ih; y++)
-        {
-            for (x = 0; x < iw; x++)
-            {
-                bezierPatchEvaluate(ww->model,
-                        (x * cell_w) / width, (y * cell_h) / height,
-                        &deformedX, &deformedY);
-
-                *v++ = deformedX;
-                *v++ = deformedY;
-
-                *uv++ = (x * cell_w) / width;
-                *uv++ = 1.0 - ((y * cell_h) / height);
-            }
-        }
+        points[2 * i]     = ww->model->positionX[i];
+        points[2 * i + 1] = ww->model->positionY[i];
     }
 }
 
@@ -615,8 +602,8 @@ void wobbly_move_notify(struct wobbly_surface *surface, int x, int y)
     WobblyWindow *ww = surface->ww;
     if (ww->grabbed)
     {
-        ww->model->anchorObject->position.x = x + ww->grab_dx;
-        ww->model->anchorObject->position.y = y + ww->grab_dy;
+        ww->model->positionX[ww->model->anchorObject] = x + ww->grab_dx;
+        ww->model->positionY[ww->model->anchorObject] = y + ww->grab_dy;
 
         ww->wobbly |= WobblyInitial;
         surface->synced = 0;
@@ -628,28 +615,11 @@ void wobbly_slight_wobble(struct wobbly_surface *surface)
     WobblyWindow *ww = surface->ww;
     if (wobblyEnsureModel(surface))
     {
-        Object *centerObj;
-        Spring *s;
-        int	   i;
+        int centerObj;
 
         centerObj = modelFindNearestObject(ww->model,
             surface->x + surface->width / 2, surface->y + surface->height / 2);
-
-        for (i = 0; i < ww->model->numSprings; i++)
-        {
-            s = &ww->model->springs[i];
-
-            if (s->a == centerObj)
-            {
-                s->b->velocity.x -= s->offset.x * 0.05f;
-                s->b->velocity.y -= s->offset.y * 0.05f;
-            }
-            else if (s->b == centerObj)
-            {
-                s->a->velocity.x += s->offset.x * 0.05f;
-                s->a->velocity.y += s->offset.y * 0.05f;
-            }
-        }
+        modelPushNeighbours(ww->model, centerObj);
 
         ww->wobbly |= WobblyInitial;
     }
@@ -671,33 +641,14 @@ void wobbly_grab_notify(struct wobbly_surface *surface, int x, int y)
 
     if (wobblyEnsureModel(surface))
     {
-        Spring *s;
-        int	   i;
+        Model *model = ww->model;
 
-        if (ww->model->anchorObject)
-            ww->model->anchorObject->immobile = 0;
-
-        ww->model->anchorObject = modelFindNearestObject(ww->model, x, y);
-        ww->model->anchorObject->immobile = 1;
-        ww->grab_dx = ww->model->anchorObject->position.x - x;
-        ww->grab_dy = ww->model->anchorObject->position.y - y;
+        modelSetAnchor(model, modelFindNearestObject(model, x, y));
+        ww->grab_dx = model->positionX[model->anchorObject] - x;
+        ww->grab_dy = model->positionY[model->anchorObject] - y;
 
         ww->grabbed = 1;
-        for (i = 0; i < ww->model->numSprings; i++)
-        {
-            s = &ww->model->springs[i];
-
-            if (s->a == ww->model->anchorObject)
-            {
-                s->b->velocity.x -= s->offset.x * 0.05f;
-                s->b->velocity.y -= s->offset.y * 0.05f;
-            }
-            else if (s->b == ww->model->anchorObject)
-            {
-                s->a->velocity.x += s->offset.x * 0.05f;
-                s->a->velocity.y += s->offset.y * 0.05f;
-            }
-        }
+        modelPushNeighbours(model, model->anchorObject);
 
         ww->wobbly |= WobblyInitial;
     }
@@ -710,11 +661,7 @@ void wobbly_ungrab_notify(struct wobbly_surface *surface)
     {
         if (ww->model)
         {
-            if (ww->model->anchorObject)
-                ww->model->anchorObject->immobile = 0;
-
-            ww->model->anchorObject = NULL;
-
+            modelSetAnchor(ww->model, -1);
             ww->wobbly |= WobblyInitial;
         }
 
@@ -751,9 +698,7 @@ void wobbly_fini(struct wobbly_surface *surface)
 
     if (ww->model)
     {
-        free(ww->model->objects);
         free(ww->model);
-        free(surface->v);
     }
 
     free (ww);
@@ -766,10 +711,9 @@ void wobbly_force_geometry(struct wobbly_surface *surface,
 
     if (wobblyEnsureModel(surface))
     {
-		if (!ww->grabbed && ww->model->anchorObject)
+		if (!ww->grabbed && ww->model->anchorObject >= 0)
 		{
-		    ww->model->anchorObject->immobile = 0;
-		    ww->model->anchorObject = NULL;
+		    modelSetAnchor(ww->model, -1);
 		}
 
         surface->x = x;
@@ -793,7 +737,8 @@ void wobbly_unenforce_geometry(struct wobbly_surface *surface)
     {
         if (modelRemoveEdgeAnchors(ww->model))
         {
-            if (!ww->model->anchorObject || !ww->model->anchorObject->immobile)
+            if (ww->model->anchorObject < 0 ||
+                !objectIsImmobile(ww->model, ww->model->anchorObject))
             {
                 modelSetMiddleAnchor(ww->model, surface->x, surface->y,
                     surface->width, surface->height);
@@ -810,10 +755,10 @@ void wobbly_translate(struct wobbly_surface *surface, int dx, int dy)
     WobblyWindow *ww = surface->ww;
     if (wobblyEnsureModel(surface))
     {
-        for (int i = 0; i < ww->model->numObjects; i++)
+        for (int i = 0; i < GRID_SIZE; i++)
         {
-            ww->model->objects[i].position.x += dx;
-            ww->model->objects[i].position.y += dy;
+            ww->model->positionX[i] += dx;
+            ww->model->positionY[i] += dy;
         }
 
         ww->model->topLeft.x += dx;
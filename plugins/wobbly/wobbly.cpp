@@ -4,6 +4,10 @@
 #include <wayfire/view-transform.hpp>
 #include <wayfire/workspace-manager.hpp>
 #include <wayfire/render-manager.hpp>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
 
 extern "C"
 {
@@ -16,17 +20,44 @@ namespace wobbly_graphics
 {
 namespace
 {
+/* Evaluates the bezier patch given by the 4x4 control points at the position
+ * of the vertex in the grid mesh */
 const char *vertex_source =
     R"(
 #version 100
-attribute mediump vec2 position;
-attribute mediump vec2 uvPosition;
+attribute highp vec2 gridPosition;
 varying highp vec2 uvpos;
 uniform mat4 MVP;
+uniform highp vec2 controlPoints[16];
+
+highp vec4 bernstein(highp float t)
+{
+    highp float s = 1.0 - t;
+    return vec4(s * s * s, 3.0 * t * s * s, 3.0 * t * t * s, t * t * t);
+}
+
+highp vec2 evaluate_row(highp vec4 coeffs, highp vec2 p0, highp vec2 p1,
+    highp vec2 p2, highp vec2 p3)
+{
+    return coeffs.x * p0 + coeffs.y * p1 + coeffs.z * p2 + coeffs.w * p3;
+}
 
 void main() {
-    gl_Position = MVP * vec4(position.xy, 0.0, 1.0);
-    uvpos = uvPosition;
+    highp vec4 cu = bernstein(gridPosition.x);
+    highp vec4 cv = bernstein(gridPosition.y);
+
+    highp vec2 position =
+        cv.x * evaluate_row(cu, controlPoints[0], controlPoints[1],
+            controlPoints[2], controlPoints[3]) +
+        cv.y * evaluate_row(cu, controlPoints[4], controlPoints[5],
+            controlPoints[6], controlPoints[7]) +
+        cv.z * evaluate_row(cu, controlPoints[8], controlPoints[9],
+            controlPoints[10], controlPoints[11]) +
+        cv.w * evaluate_row(cu, controlPoints[12], controlPoints[13],
+            controlPoints[14], controlPoints[15]);
+
+    gl_Position = MVP * vec4(position, 0.0, 1.0);
+    uvpos = vec2(gridPosition.x, 1.0 - gridPosition.y);
 }
 )";
 
@@ -71,98 +102,141 @@ void destroy_program()
 }
 
 /**
- * Enumerate the needed triangles for rendering the model
+ * A static grid mesh covering the unit square, with the given number of
+ * cells. The actual vertex positions are calculated in the vertex shader
+ * from the control points of the wobbly model, so the mesh is uploaded once
+ * and the CPU cost doesn't depend on the grid resolution.
  */
-void prepare_geometry(wobbly_surface *model, wf::geometry_t src_box,
-    std::vector<float>& vert, std::vector<float>& uv)
+class grid_mesh_t
 {
-    float x = src_box.x, y = src_box.y, w = src_box.width, h = src_box.height;
-    std::vector<int> idx;
-
-    int per_row = model->x_cells + 1;
-
-    for (int j = 0; j < model->y_cells; j++)
+  public:
+    /* Requires bound opengl context */
+    void init(int x_cells, int y_cells)
     {
-        for (int i = 0; i < model->x_cells; i++)
+        const int per_row = x_cells + 1;
+
+        std::vector<GLushort> idx;
+        idx.reserve(6 * x_cells * y_cells);
+        for (int j = 0; j < y_cells; j++)
         {
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
-            idx.push_back(i * per_row + j + 1);
+            for (int i = 0; i < x_cells; i++)
+            {
+                idx.push_back(j * per_row + i);
+                idx.push_back((j + 1) * per_row + i + 1);
+                idx.push_back((j + 1) * per_row + i);
 
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
+                idx.push_back(j * per_row + i);
+                idx.push_back(j * per_row + i + 1);
+                idx.push_back((j + 1) * per_row + i + 1);
+            }
         }
-    }
 
-    if (!model->v || !model->uv)
-    {
-        for (auto id : idx)
+        std::vector<float> grid;
+        grid.reserve(2 * per_row * (y_cells + 1));
+        for (int j = 0; j <= y_cells; j++)
         {
-            float tile_w = w / model->x_cells;
-            float tile_h = h / model->y_cells;
+            for (int i = 0; i <= x_cells; i++)
+            {
+                grid.push_back(1.0f * i / x_cells);
+                grid.push_back(1.0f * j / y_cells);
+            }
+        }
 
-            int i = id / per_row;
-            int j = id % per_row;
+        index_count = idx.size();
+        GL_CALL(glGenBuffers(1, &index_buffer));
+        GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer));
+        GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            idx.size() * sizeof(GLushort), idx.data(), GL_STATIC_DRAW));
+        GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+        GL_CALL(glGenBuffers(1, &grid_buffer));
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, grid_buffer));
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER,
+            grid.size() * sizeof(float), grid.data(), GL_STATIC_DRAW));
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
 
-            vert.push_back(i * tile_w + x);
-            vert.push_back(j * tile_h + y);
+    /* Requires bound opengl context */
+    void release()
+    {
+        GL_CALL(glDeleteBuffers(1, &index_buffer));
+        GL_CALL(glDeleteBuffers(1, &grid_buffer));
+        index_buffer = grid_buffer = 0;
+    }
 
-            uv.push_back(1.0f * i / model->x_cells);
-            uv.push_back(1.0f - 1.0f * j / model->y_cells);
-        }
-    } else
+    /**
+     * Render the mesh deformed by the given control points, stored row by
+     * row as 2 * WOBBLY_CONTROL_POINTS floats.
+     *
+     * Requires bound opengl context.
+     */
+    void render(wf::texture_t tex, glm::mat4 mat, const float *control_points)
     {
-        for (auto i : idx)
-        {
-            vert.push_back(model->v[2 * i]);
-            vert.push_back(model->v[2 * i + 1]);
+        program.use(tex.type);
+        program.set_active_texture(tex);
 
-            uv.push_back(model->uv[2 * i]);
-            uv.push_back(model->uv[2 * i + 1]);
-        }
-    }
-}
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, grid_buffer));
+        program.attrib_pointer("gridPosition", 2, 0, nullptr);
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+        program.uniformMatrix4f("MVP", mat);
 
-/* Requires bound opengl context */
-void render_triangles(wf::texture_t tex, glm::mat4 mat, float *pos, float *uv,
-    int cnt)
-{
-    program.use(tex.type);
-    program.set_active_texture(tex);
+        GLint loc = GL_CALL(glGetUniformLocation(
+            program.get_program_id(tex.type), "controlPoints"));
+        GL_CALL(glUniform2fv(loc, WOBBLY_CONTROL_POINTS, control_points));
 
-    program.attrib_pointer("position", 2, 0, pos);
-    program.attrib_pointer("uvPosition", 2, 0, uv);
-    program.uniformMatrix4f("MVP", mat);
+        GL_CALL(glEnable(GL_BLEND));
+        GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 
-    GL_CALL(glEnable(GL_BLEND));
-    GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+        GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer));
+        GL_CALL(glDrawElements(GL_TRIANGLES, index_count,
+            GL_UNSIGNED_SHORT, nullptr));
+        GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+        GL_CALL(glDisable(GL_BLEND));
 
-    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3 * cnt));
-    GL_CALL(glDisable(GL_BLEND));
+        program.deactivate();
+    }
 
-    program.deactivate();
-}
+  private:
+    int index_count = 0;
+    GLuint index_buffer = 0;
+    GLuint grid_buffer  = 0;
+};
 }
 
+/* The options are created on first use rather than when the plugin is loaded,
+ * so that loading it doesn't access the configuration */
 namespace wobbly_settings
 {
-wf::option_wrapper_t<double> friction{"wobbly/friction"};
-wf::option_wrapper_t<double> spring_k{"wobbly/spring_k"};
-wf::option_wrapper_t<int> resolution{"wobbly/grid_resolution"};
+static double get_friction()
+{
+    static wf::option_wrapper_t<double> friction{"wobbly/friction"};
+    return friction;
+}
+
+static double get_spring_k()
+{
+    static wf::option_wrapper_t<double> spring_k{"wobbly/spring_k"};
+    return spring_k;
+}
+
+static int get_resolution()
+{
+    static wf::option_wrapper_t<int> resolution{"wobbly/grid_resolution"};
+    return resolution;
+}
 }
 
 extern "C"
 {
     double wobbly_settings_get_friction()
     {
-        return wf::clamp((double)wobbly_settings::friction,
+        return wf::clamp(wobbly_settings::get_friction(),
             MINIMAL_FRICTION, MAXIMAL_FRICTION);
     }
 
     double wobbly_settings_get_spring_k()
     {
-        return wf::clamp((double)wobbly_settings::spring_k,
+        return wf::clamp(wobbly_settings::get_spring_k(),
             MINIMAL_SPRING_K, MAXIMAL_SPRING_K);
     }
 }
@@ -251,7 +325,6 @@ class iwobbly_state_t
     virtual void translate_model(int dx, int dy)
     {
         wobbly_translate(model.get(), dx, dy);
-        wobbly_add_geometry(model.get());
 
         wm_geometry.x  += dx;
         wm_geometry.y  += dy;
@@ -483,10 +556,112 @@ class wobbly_state_free_t : public iwobbly_state_t
 };
 }
 
+class wf_wobbly;
+
+/**
+ * Steps the models of all wobbly views on an output together, once per frame.
+ * It is stored as custom data on each output where the wobbly plugin is
+ * loaded.
+ */
+class wobbly_batch_t : public wf::custom_data_t
+{
+  public:
+    wobbly_batch_t(wf::output_t *output)
+    {
+        this->output = output;
+        pre_hook     = [=] () { step(); };
+    }
+
+    ~wobbly_batch_t()
+    {
+        if (!members.empty())
+        {
+            output->render->rem_effect(&pre_hook);
+        }
+    }
+
+    void add(wf_wobbly *wobbly)
+    {
+        if (members.empty())
+        {
+            output->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+        }
+
+        members.push_back(wobbly);
+    }
+
+    /**
+     * Create a grid mesh with the given number of cells in each direction.
+     * The mesh is released when the last reference to it is dropped.
+     */
+    static std::shared_ptr<wobbly_graphics::grid_mesh_t> create_mesh(int cells)
+    {
+        auto release = [] (wobbly_graphics::grid_mesh_t *mesh)
+        {
+            OpenGL::render_begin();
+            mesh->release();
+            OpenGL::render_end();
+            delete mesh;
+        };
+
+        std::shared_ptr<wobbly_graphics::grid_mesh_t> mesh{
+            new wobbly_graphics::grid_mesh_t, release};
+        OpenGL::render_begin();
+        mesh->init(cells, cells);
+        OpenGL::render_end();
+
+        return mesh;
+    }
+
+    /**
+     * Get the mesh with the given number of cells. The mesh depends only on
+     * the grid resolution, so it is shared by all views on the output.
+     */
+    std::shared_ptr<wobbly_graphics::grid_mesh_t> get_mesh(int cells)
+    {
+        auto mesh = meshes[cells].lock();
+        if (!mesh)
+        {
+            mesh = create_mesh(cells);
+            meshes[cells] = mesh;
+        }
+
+        return mesh;
+    }
+
+    void remove(wf_wobbly *wobbly)
+    {
+        auto it = std::find(members.begin(), members.end(), wobbly);
+        if (it == members.end())
+        {
+            return;
+        }
+
+        members.erase(it);
+        if (members.empty())
+        {
+            output->render->rem_effect(&pre_hook);
+        }
+    }
+
+  private:
+    wf::output_t *output;
+    wf::effect_hook_t pre_hook;
+    std::vector<wf_wobbly*> members;
+    std::map<int, std::weak_ptr<wobbly_graphics::grid_mesh_t>> meshes;
+
+    bool is_member(wf_wobbly *wobbly) const
+    {
+        return std::find(members.begin(), members.end(), wobbly) !=
+               members.end();
+    }
+
+    void step();
+};
+
 class wf_wobbly : public wf::view_transformer_t
 {
     wayfire_view view;
-    wf::effect_hook_t pre_hook;
 
     wf::signal_callback_t view_removed = [=] (wf::signal_data_t*)
     {
@@ -511,7 +686,7 @@ class wf_wobbly : public wf::view_transformer_t
         if (!view->get_output())
         {
             // Destructor won't be able to disconnect bc view output is invalid
-            sig->output->render->rem_effect(&pre_hook);
+            leave_batch(sig->output);
 
             return destroy_self();
         }
@@ -524,16 +699,53 @@ class wf_wobbly : public wf::view_transformer_t
         auto new_geometry = view->get_output()->get_layout_geometry();
         state->translate_model(old_geometry.x - new_geometry.x,
             old_geometry.y - new_geometry.y);
+        update_control_points();
 
-        sig->output->render->rem_effect(&pre_hook);
-        view->get_output()->render->add_effect(&pre_hook,
-            wf::OUTPUT_EFFECT_PRE);
+        leave_batch(sig->output);
+        if (!join_batch(view->get_output()))
+        {
+            return destroy_self();
+        }
     };
 
     std::unique_ptr<wobbly_surface> model;
     std::unique_ptr<wf::iwobbly_state_t> state;
     uint32_t last_frame;
 
+    std::shared_ptr<wobbly_graphics::grid_mesh_t> mesh;
+    /* The control points of the model at the last frame. They are valid
+     * only after the model has been stepped at least once. */
+    std::array<float, 2 * WOBBLY_CONTROL_POINTS> control_points;
+    bool has_control_points = false;
+
+    void update_control_points()
+    {
+        if (has_control_points)
+        {
+            wobbly_get_control_points(model.get(), control_points.data());
+        }
+    }
+
+    bool join_batch(wf::output_t *output)
+    {
+        auto batch = output->get_data<wobbly_batch_t>();
+        if (batch)
+        {
+            batch->add(this);
+        }
+
+        return batch != nullptr;
+    }
+
+    void leave_batch(wf::output_t *output)
+    {
+        auto batch = output->get_data<wobbly_batch_t>();
+        if (batch)
+        {
+            batch->remove(this);
+        }
+    }
+
     void init_model()
     {
         model = std::make_unique<wobbly_surface>();
@@ -547,12 +759,16 @@ class wf_wobbly : public wf::view_transformer_t
         model->grabbed = 0;
         model->synced  = 1;
 
-        model->x_cells = wobbly_settings::resolution;
-        model->y_cells = wobbly_settings::resolution;
+        /* The mesh is rendered with 16-bit indices */
+        model->x_cells = wf::clamp(wobbly_settings::get_resolution(), 1, 255);
+        model->y_cells = model->x_cells;
 
-        model->v  = NULL;
-        model->uv = NULL;
         wobbly_init(model.get());
+
+        auto output = view->get_output();
+        auto batch  = output ? output->get_data<wobbly_batch_t>() : nullptr;
+        mesh = batch ? batch->get_mesh(model->x_cells) :
+            wobbly_batch_t::create_mesh(model->x_cells);
     }
 
   public:
@@ -561,9 +777,7 @@ class wf_wobbly : public wf::view_transformer_t
         this->view = view;
         init_model();
         last_frame = wf::get_current_time();
-
-        pre_hook = [=] () { update_model(); };
-        view->get_output()->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+        join_batch(view->get_output());
 
         view->connect_signal("unmapped", &view_removed);
         view->connect_signal("tiled", &view_state_changed);
@@ -606,7 +820,13 @@ class wf_wobbly : public wf::view_transformer_t
         return point;
     }
 
-    void update_model()
+    /**
+     * Prepare the model for the next frame. The model itself is stepped
+     * afterwards by the batch, together with the other wobbly views.
+     *
+     * @return The time since the last frame in milliseconds.
+     */
+    int begin_frame()
     {
         view->damage();
 
@@ -617,14 +837,24 @@ class wf_wobbly : public wf::view_transformer_t
         state->handle_frame();
         view->connect_signal("geometry-changed", &this->view_geometry_changed);
 
-        /* Update all the wobbly model */
         auto now = wf::get_current_time();
-        wobbly_prepare_paint(model.get(), now - last_frame);
-
-        /* Update wobbly geometry */
+        int elapsed = now - last_frame;
         last_frame = now;
-        wobbly_add_geometry(model.get());
+
+        return elapsed;
+    }
+
+    wobbly_surface *get_model()
+    {
+        return model.get();
+    }
+
+    /** Update the geometry after the model has been stepped. */
+    void end_frame()
+    {
         wobbly_done_paint(model.get());
+        has_control_points = true;
+        update_control_points();
         view->damage();
 
         if (state->is_wobbly_done())
@@ -639,12 +869,26 @@ class wf_wobbly : public wf::view_transformer_t
         OpenGL::render_begin(target_fb);
         target_fb.logic_scissor(scissor_box);
 
-        std::vector<float> vert, uv;
-        wobbly_graphics::prepare_geometry(model.get(), src_box, vert, uv);
-        wobbly_graphics::render_triangles(src_tex,
-            target_fb.get_orthographic_projection(),
-            vert.data(), uv.data(),
-            model->x_cells * model->y_cells * 2);
+        if (has_control_points)
+        {
+            mesh->render(src_tex, target_fb.get_orthographic_projection(),
+                control_points.data());
+        } else
+        {
+            /* Evenly spaced control points result in a flat patch */
+            std::array<float, 2 * WOBBLY_CONTROL_POINTS> flat;
+            for (int j = 0; j < 4; j++)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    flat[2 * (j * 4 + i)]     = src_box.x + src_box.width * i / 3.0f;
+                    flat[2 * (j * 4 + i) + 1] = src_box.y + src_box.height * j / 3.0f;
+                }
+            }
+
+            mesh->render(src_tex, target_fb.get_orthographic_projection(),
+                flat.data());
+        }
 
         OpenGL::render_end();
     }
@@ -758,6 +1002,7 @@ class wf_wobbly : public wf::view_transformer_t
     void translate(wf::point_t delta)
     {
         state->translate_model(delta.x, delta.y);
+        update_control_points();
     }
 
     void end_grab()
@@ -783,7 +1028,7 @@ class wf_wobbly : public wf::view_transformer_t
 
         if (view->get_output())
         {
-            view->get_output()->render->rem_effect(&pre_hook);
+            leave_batch(view->get_output());
         }
 
         view->disconnect_signal("unmapped", &view_removed);
@@ -794,6 +1039,44 @@ class wf_wobbly : public wf::view_transformer_t
     }
 };
 
+void wobbly_batch_t::step()
+{
+    /* Views may leave the batch while it is being processed, for ex. when
+     * their animation ends */
+    auto current = members;
+
+    std::vector<std::pair<wf_wobbly*, int>> started;
+    for (auto& wobbly : current)
+    {
+        if (is_member(wobbly))
+        {
+            started.push_back({wobbly, wobbly->begin_frame()});
+        }
+    }
+
+    std::vector<wf_wobbly*> stepped;
+    std::vector<wobbly_surface*> models;
+    std::vector<int> elapsed;
+    for (auto& [wobbly, ms] : started)
+    {
+        if (is_member(wobbly))
+        {
+            stepped.push_back(wobbly);
+            models.push_back(wobbly->get_model());
+            elapsed.push_back(ms);
+        }
+    }
+
+    wobbly_prepare_paint_batch(models.data(), elapsed.data(), models.size());
+    for (auto& wobbly : stepped)
+    {
+        if (is_member(wobbly))
+        {
+            wobbly->end_frame();
+        }
+    }
+}
+
 class wayfire_wobbly : public wf::plugin_interface_t
 {
     wf::signal_callback_t wobbly_changed;
@@ -810,6 +1093,7 @@ class wayfire_wobbly : public wf::plugin_interface_t
         };
 
         output->connect_signal("wobbly-event", &wobbly_changed);
+        output->store_data(std::make_unique<wobbly_batch_t>(output));
 
         wobbly_graphics::load_program();
     }
@@ -874,6 +1158,7 @@ class wayfire_wobbly : public wf::plugin_interface_t
             }
         }
 
+        output->erase_data<wobbly_batch_t>();
         wobbly_graphics::destroy_program();
         output->disconnect_signal("wobbly-event", &wobbly_changed);
     }
@@ -15,6 +15,9 @@
 #define MAXIMAL_SPRING_K 10.0
 #define WOBBLY_MASS 15.0
 
+/* The model is a bezier patch with 4x4 control points */
+#define WOBBLY_CONTROL_POINTS 16
+
 double wobbly_settings_get_friction();
 double wobbly_settings_get_spring_k();
 
@@ -24,9 +27,6 @@ struct wobbly_surface
    int x, y, width, height;
    int x_cells, y_cells;
    int grabbed, synced;
-   int vertex_count;
-
-   GLfloat *v, *uv;
 };
 
 struct wobbly_rect
@@ -47,10 +47,15 @@ void wobbly_ungrab_notify(struct wobbly_surface *surface);
 void wobbly_resize(struct wobbly_surface *surface, int width, int height);
 void wobbly_move_notify(struct wobbly_surface *surface, int x, int y);
 void wobbly_prepare_paint(struct wobbly_surface *surface, int msSinceLastPaint);
+void wobbly_prepare_paint_batch(struct wobbly_surface **surfaces,
+    const int *msSinceLastPaint, int count);
 void wobbly_done_paint(struct wobbly_surface *surface);
-void wobbly_add_geometry(struct wobbly_surface *surface);
 struct wobbly_rect wobbly_boundingbox(struct wobbly_surface *surface);
 
+/* Store the control points of the bezier patch row by row in points, which
+ * must have space for 2 * WOBBLY_CONTROL_POINTS floats */
+void wobbly_get_control_points(struct wobbly_surface *surface, float *points);
+
 void wobbly_force_geometry(struct wobbly_surface *surface,
     int x, int y, int w, int h);
 void wobbly_unenforce_geometry(struct wobbly_surface *surface);
@@ -34,6 +34,7 @@ namespace wf
 class output_t;
 class output_layout_t;
 class input_device_t;
+class thread_pool_t;
 
 /** Describes the state of the compositor */
 enum class compositor_state_t
@@ -306,6 +307,12 @@ class compositor_core_t : public wf::object_base_t
      */
     virtual compositor_state_t get_current_state() = 0;
 
+    /**
+     * @return The thread pool shared by the compositor and all plugins.
+     *   The worker threads are started the first time the pool is requested.
+     */
+    virtual wf::thread_pool_t& get_thread_pool() = 0;
+
     /**
      * Shut down the whole compositor.
      *
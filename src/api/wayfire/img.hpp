@@ -2,19 +2,56 @@
 #define IMG_HPP_
 
 #include <GLES2/gl2.h>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace image_io
 {
+/* A decoded image. The rows are stored from top to bottom, without padding. */
+struct image_t
+{
+    int width  = 0;
+    int height = 0;
+    /* Either GL_RGBA or GL_RGB */
+    GLenum format = GL_RGBA;
+    std::vector<uint8_t> pixels;
+};
+
 /* Load the image from the given file, binding it to the given GL texture target
  * Bind the texture before you call this function
  * Guaranteed: doesn't change any GL state except pixel packing */
 bool load_from_file(std::string name, GLuint target);
 
+/* Called with the decoded image, or with nullptr if loading failed */
+using load_callback_t = std::function<void (std::shared_ptr<const image_t>)>;
+
+/* Decode the image from the given file on a worker thread, and call the
+ * callback with the result on the main thread.
+ *
+ * Decoded images are cached by the contents of the file, so loading the same
+ * image again (even from another file) doesn't decode it again. */
+void load_from_file_async(std::string name, load_callback_t callback);
+
+/* Upload a decoded image to the given GL texture target
+ * Bind the texture before you call this function
+ * Guaranteed: doesn't change any GL state except pixel packing */
+void upload_to_texture(const image_t& image, GLuint target);
+
 /* Function that saves the given pixels(in rgba format) to a (currently) png file */
 void write_to_file(std::string name, uint8_t *pixels, int w, int h,
     std::string type);
 
+/* Same as write_to_file(), but the image is encoded and written on a worker
+ * thread, so the compositor doesn't block. The pixel buffer is taken over.
+ *
+ * When the file has been written, or writing it has failed for any reason, the
+ * image-written signal is emitted on core.
+ * compression_level is the zlib level (0-9) for png, or -1 for the default. */
+void write_to_file_async(std::string name, std::vector<uint8_t> pixels, int w,
+    int h, std::string type, int compression_level = -1);
+
 /* Initializes all backends, called at startup */
 void init();
 }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <wayfire/view.hpp>
+#include <wayfire/nonstd/noncopyable.hpp>
+
+namespace wf
+{
+/**
+ * A layout transaction changes the geometry of several views at once, so that
+ * the new layout is shown in a single frame instead of views jumping to their
+ * new places one by one as their clients resize. This is meant for plugins
+ * which arrange many views together, like tiling or grid plugins.
+ *
+ * The geometries are collected with set_geometry() and applied on commit().
+ * At that point all views are configured, and the outputs they are on stop
+ * painting new frames until the client of every view which has to change its
+ * size commits a new size, or until the timeout given by the
+ * core/transaction_timeout option passes. The whole change is then painted at
+ * once. The new size doesn't have to match the requested one, since clients
+ * may clamp or round it.
+ *
+ * Since frames are held, transactions are not suitable for continuous changes
+ * like interactive resizing.
+ *
+ * If a view is part of a transaction which is still waiting when a new one is
+ * committed, its geometry from the new transaction wins. New transactions do
+ * not extend the timeout of the ones still waiting.
+ */
+class layout_transaction_t : public noncopyable_t
+{
+  public:
+    layout_transaction_t() = default;
+
+    /** Commits the transaction if it hasn't been committed yet */
+    ~layout_transaction_t();
+
+    /**
+     * Set the wm geometry the view should have once the transaction is
+     * committed. Setting the geometry of the same view again overrides the
+     * previous geometry.
+     */
+    void set_geometry(wayfire_view view, wf::geometry_t geometry);
+
+    /** @return true if no geometry has been set since the last commit. */
+    bool empty() const;
+
+    /** Apply all geometries set since the last commit. */
+    void commit();
+
+  private:
+    std::vector<std::pair<wayfire_view, wf::geometry_t>> pending;
+};
+}
@@ -178,6 +178,14 @@ void render_end();
 /* Clear the currently bound framebuffer with the given color */
 void clear(wf::color_t color, uint32_t mask = GL_COLOR_BUFFER_BIT);
 
+/**
+ * @return Whether mipmaps can be generated for and sampled from textures whose
+ * size is not a power of two, i.e whether the context is GLES3 or has the
+ * GL_OES_texture_npot extension. Without it, such textures are incomplete
+ * when sampled with mipmaps and TEXTURE_USE_MIPMAPS must not be used.
+ */
+bool supports_npot_mipmaps();
+
 
 enum texture_rendering_flags_t
 {
@@ -187,6 +195,9 @@ enum texture_rendering_flags_t
     TEXTURE_TRANSFORM_INVERT_Y = (1 << 1),
     /* Use a subrectangle of the texture to render */
     TEXTURE_USE_TEX_GEOMETRY   = (1 << 2),
+    /* Sample the texture with trilinear filtering. The texture must have
+     * a complete mipmap chain, for ex. by calling glGenerateMipmap() */
+    TEXTURE_USE_MIPMAPS        = (1 << 3),
 };
 
 /**
@@ -56,6 +56,28 @@ enum output_effect_type_t
 using post_hook_t = std::function<void (const wf::framebuffer_base_t& source,
     const wf::framebuffer_base_t& destination)>;
 
+/**
+ * Timing information about the last painted frame of an output.
+ * All times are in microseconds.
+ */
+struct frame_timing_t
+{
+    /** The refresh interval of the output, or 0 if it is not known */
+    int64_t refresh_interval = 0;
+    /**
+     * The time between the start of the painting of the last two frames,
+     * or -1 if the output was idle before the last frame, i.e. it did not
+     * paint for more than two and a half refresh intervals.
+     */
+    int64_t frame_interval = -1;
+    /**
+     * The time it took to paint the last frame, from the start of the repaint
+     * until the buffers were swapped. Note that GPU work still pending after
+     * submitting the frame is not included.
+     */
+    int64_t render_time = 0;
+};
+
 /** Render manager
  *
  * Each output has a render manager, which is responsible for all rendering
@@ -75,6 +97,18 @@ class render_manager : public wf::signal_provider_t
      */
     void set_renderer(render_hook_t rh = nullptr);
 
+    /**
+     * By default, the render hook set with set_renderer() is assumed to
+     * repaint the whole output on every frame. A render hook can call this
+     * function to report that it repainted only a part of it instead.
+     *
+     * The region must contain at least get_scheduled_damage(), because parts
+     * of the output buffer may be outdated due to double buffering.
+     *
+     * @param region The repainted region, in output-local coordinates.
+     */
+    void set_renderer_damage(const wf::region_t& region);
+
     /**
      * Rendering an output is done on demand, that is, when the output is
      * damaged. Some plugins however need to redraw the output as often as
@@ -100,6 +134,14 @@ class render_manager : public wf::signal_provider_t
      */
     void add_inhibit(bool add);
 
+    /**
+     * Hold back new frames on the output. While held, the output keeps showing
+     * the last painted frame, and damage is accumulated until the hold is
+     * released. Used to present several changes at once, see
+     * wf::layout_transaction_t.
+     */
+    void add_frame_hold(bool add);
+
     /**
      * Add a new effect hook.
      * @param hook The hook callback
@@ -181,6 +223,13 @@ class render_manager : public wf::signal_provider_t
      */
     wf::framebuffer_t get_target_framebuffer() const;
 
+    /**
+     * @return Timing information about the last painted frame. Plugins can use
+     *   it to reduce the quality of expensive effects when the output does not
+     *   manage to repaint in time.
+     */
+    frame_timing_t get_frame_timing() const;
+
     /**
      * Initialize a workspace stream. If you need to change the stream's
      * attributes, you should stop the stream, and start it again
@@ -194,9 +243,14 @@ class render_manager : public wf::signal_provider_t
      * This function should be called inside the rendering cycle, i.e in a
      * render or an overlay hook.
      *
+     * The stream can be rendered with a reduced resolution, for ex. when it is
+     * displayed much smaller than the output. Changing the scale causes a full
+     * repaint of the stream.
+     *
      * @param stream The workspace stream to update
-     * @param scale_x Unused for now
-     * @param scale_y Unused for now
+     * @param scale_x, scale_y The resolution of the stream relative to the
+     *   output, in (0, 1]. Only uniform scaling is supported, so the larger of
+     *   the two is used for both dimensions.
      */
     void workspace_stream_update(workspace_stream_t& stream,
         float scale_x = 1, float scale_y = 1);
@@ -208,6 +262,27 @@ class render_manager : public wf::signal_provider_t
      */
     void workspace_stream_stop(workspace_stream_t& stream);
 
+    /**
+     * Render the views of a workspace directly onto the given framebuffer,
+     * without an intermediate workspace stream. When the workspace doesn't need
+     * to be scaled, this is much cheaper than updating a stream and rendering
+     * its texture. Like workspace_stream_update(), this function should be
+     * called inside the rendering cycle.
+     *
+     * The workspace-stream-pre and workspace-stream-post signals are emitted
+     * as for workspace streams.
+     *
+     * @param ws The workspace to render.
+     * @param fb The framebuffer to render onto.
+     * @param position The position of the workspace's top-left corner, in the
+     *   coordinate system of the framebuffer's geometry.
+     * @param damage The region of the framebuffer to repaint, in the coordinate
+     *   system of its geometry. Only the part covered by the workspace is
+     *   repainted.
+     */
+    void render_workspace(wf::point_t ws, const wf::framebuffer_t& fb,
+        wf::point_t position, const wf::region_t& damage);
+
   private:
     class impl;
     std::unique_ptr<impl> pimpl;
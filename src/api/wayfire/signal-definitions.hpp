@@ -111,7 +111,8 @@ struct surface_map_state_changed_signal : public wf::signal_data_t
 /**
  * name: reload-config
  * on: core
- * when: When the config file is reloaded
+ * when: When the config file is reloaded and at least one option has
+ *   changed. The updated handlers of the changed options run before it.
  * argument: unused
  */
 
@@ -126,6 +127,20 @@ struct keyboard_focus_changed_signal : public wf::signal_data_t
     wlr_surface *surface;
 };
 
+/**
+ * name: image-written
+ * on: core
+ * when: When an image queued with image_io::write_to_file_async() has been
+ *   written (or writing it has failed).
+ */
+struct image_written_signal : public wf::signal_data_t
+{
+    /** The name of the file */
+    std::string filename;
+    /** Whether the image was written successfully */
+    bool success;
+};
+
 /* ----------------------------------------------------------------------------/
  * Output signals
  * -------------------------------------------------------------------------- */
@@ -527,11 +542,18 @@ struct view_geometry_changed_signal : public _view_signal
 
 /**
  * name: region-damaged
- * on: view
+ * on: view, output(view-)
  * when: Whenever a region of the view becomes damaged, for ex. when the client
  *   updates its contents.
- * argument: Unused.
  */
+struct view_region_damaged_signal : public _view_signal
+{
+    /**
+     * The damaged box, after applying the view's transformers, in
+     * output-local coordinates.
+     */
+    wf::geometry_t box;
+};
 
 /**
  * name: decoration-state-updated
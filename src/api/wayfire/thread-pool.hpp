@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <wayfire/nonstd/noncopyable.hpp>
+
+namespace wf
+{
+/**
+ * A pool of worker threads, shared by the compositor and all plugins.
+ * It can be obtained via wf::get_core().get_thread_pool().
+ *
+ * The worker threads are created once and live until the compositor exits,
+ * so plugins can offload work to them every frame without paying for thread
+ * creation. Each worker has its own task queue, and idle workers steal tasks
+ * from the queues of busy workers.
+ *
+ * Tasks must not access Wayland or wlroots objects, nor use OpenGL.
+ */
+class thread_pool_t : public noncopyable_t
+{
+  public:
+    using task_t = std::function<void ()>;
+
+    /**
+     * Create a new thread pool.
+     *
+     * @param num_workers The number of worker threads to start. If it is
+     *   negative, one less than the number of CPU cores is used, because the
+     *   main thread also does work in parallel_for().
+     */
+    thread_pool_t(int num_workers = -1);
+    ~thread_pool_t();
+
+    /** @return The number of worker threads in the pool. */
+    int get_num_workers() const;
+
+    /**
+     * Run the given task on one of the worker threads. If the pool has no
+     * workers, the task is executed immediately on the calling thread.
+     */
+    void submit(task_t task);
+
+    /**
+     * Run the given task on one of the worker threads, and afterwards call
+     * the completion on the main thread, from the event loop. This is the way
+     * to hand results of background work back to code which may use Wayland
+     * objects or OpenGL.
+     *
+     * This function may be called only from the main thread.
+     */
+    void submit(task_t task, task_t completion);
+
+    /**
+     * Split the range [begin, end) in chunks of at most grain_size elements
+     * and call func(chunk_begin, chunk_end) for each of them in parallel.
+     *
+     * The calling thread processes chunks too, and the function returns only
+     * after all chunks have been processed.
+     */
+    void parallel_for(int begin, int end, int grain_size,
+        const std::function<void(int, int)>& func);
+
+  private:
+    class impl;
+    std::unique_ptr<impl> priv;
+};
+}
@@ -22,6 +22,16 @@ enum transformer_z_order_t
 class view_transformer_t
 {
   public:
+    /**
+     * Whether the view should be sampled from a mipmapped snapshot (thumbnail)
+     * when this transformer shrinks it. This is meant for plugins which show
+     * many small views at once, like scale or switcher.
+     *
+     * Only has an effect if all transformers of the view can be fused, see
+     * get_fused_transform().
+     */
+    bool use_thumbnail = false;
+
     /**
      * Get the Z ordering of the transformer, e.g the order in which it should
      * be applied relative to the other transformers on the same view.
@@ -107,6 +117,26 @@ class view_transformer_t
         wlr_box scissor_box, const wf::framebuffer_t& target_fb)
     {}
 
+    /**
+     * Describe the transformer as a single matrix and a color multiplier.
+     *
+     * Consecutive transformers which can be described in this way are fused
+     * and rendered in a single pass, without an intermediate framebuffer.
+     * Transformers which override render_box() or render_with_damage() with
+     * anything other than a textured quad must not return true here.
+     *
+     * @param view The bounding box of the view up to this transformer, in
+     *   output-local coordinates.
+     * @param matrix Will be set to a matrix which maps output-local points
+     *   before the transform to homogeneous output-local points after it.
+     * @param color Will be set to a color multiplier for each channel.
+     *
+     * @return Whether the transformer can be fused. The default implementation
+     *   returns false.
+     */
+    virtual bool get_fused_transform(wf::geometry_t view,
+        glm::mat4& matrix, glm::vec4& color);
+
     virtual ~view_transformer_t()
     {}
 };
@@ -138,6 +168,8 @@ class view_2D : public view_transformer_t
         wf::geometry_t view, wf::pointf_t point) override;
     void render_box(wf::texture_t src_tex, wlr_box src_box,
         wlr_box scissor_box, const wf::framebuffer_t& target_fb) override;
+    bool get_fused_transform(wf::geometry_t view,
+        glm::mat4& matrix, glm::vec4& color) override;
 };
 
 /* Those are centered relative to the view's bounding box */
@@ -166,6 +198,8 @@ class view_3D : public view_transformer_t
         wf::geometry_t view, wf::pointf_t point) override;
     void render_box(wf::texture_t src_tex, wlr_box src_box,
         wlr_box scissor_box, const wf::framebuffer_t& target_fb) override;
+    bool get_fused_transform(wf::geometry_t view,
+        glm::mat4& matrix, glm::vec4& color) override;
 
     static const float fov; // PI / 8
     static glm::mat4 default_view_matrix();
@@ -17,6 +17,10 @@ struct workspace_stream_t
     float scale_x = 1.0;
     float scale_y = 1.0;
 
+    /* Whether the mipmaps of buffer.tex are up-to-date. Reset by the render
+     * manager whenever the stream contents change. */
+    bool has_mipmaps = false;
+
     /* The background color of the stream, when there is no view above it.
      * All streams start with -1.0 alpha to indicate that the color is
      * invalid. In this case, we use the default color, which can
@@ -31,7 +35,8 @@ struct workspace_stream_t
 /**
  * name: workspace-stream-pre, workspace-stream-post
  * on: render-manager
- * when: Immediately before(after) repainting a workspace stream.
+ * when: Immediately before(after) repainting a workspace stream, or a
+ *   workspace rendered directly with render_manager::render_workspace().
  */
 struct stream_signal_t : public wf::signal_data_t
 {
@@ -44,7 +49,9 @@ struct stream_signal_t : public wf::signal_data_t
     wf::point_t ws;
     /** The damage on the stream, in output-local coordinates */
     wf::region_t& raw_damage;
-    /** The framebuffer of the stream, fb has output-local geometry. */
+    /** The framebuffer of the stream, fb has output-local geometry. When
+     * rendering directly to a framebuffer, its geometry is translated so that
+     * the workspace is at the right position. */
     const wf::framebuffer_t& fb;
 };
 }
@@ -96,6 +96,7 @@ class compositor_core_impl_t : public compositor_core_t
     pid_t run(std::string command) override;
     void shutdown() override;
     compositor_state_t get_current_state() override;
+    wf::thread_pool_t& get_thread_pool() override;
 
   private:
     wf::wl_listener_wrapper decoration_created;
@@ -109,6 +110,7 @@ class compositor_core_impl_t : public compositor_core_t
 
     wf::output_t *active_output = nullptr;
     std::vector<std::unique_ptr<wf::view_interface_t>> views;
+    std::unique_ptr<wf::thread_pool_t> thread_pool;
 
     /* pairs (layer, request_id) */
     std::set<std::pair<uint32_t, int>> layer_focus_requests;
@@ -14,10 +14,12 @@
 #include <wayfire/output-layout.hpp>
 #include <wayfire/workspace-manager.hpp>
 #include <wayfire/signal-definitions.hpp>
+#include <wayfire/thread-pool.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
 
 #include "seat/keyboard.hpp"
 #include "opengl-priv.hpp"
+#include "startup-timeline.hpp"
 #include "seat/input-manager.hpp"
 #include "seat/input-method-relay.hpp"
 #include "seat/touch.hpp"
@@ -172,6 +174,7 @@ struct wlr_idle_inhibitor_t : public wf::idle_inhibitor_t
 
 void wf::compositor_core_impl_t::init()
 {
+    startup_timeline::phase_t init_phase{"core init"};
     wlr_renderer_init_wl_display(renderer, display);
 
     /* Order here is important:
@@ -191,12 +194,18 @@ void wf::compositor_core_impl_t::init()
     protocols.data_control = wlr_data_control_manager_v1_create(display);
 
     output_layout = std::make_unique<wf::output_layout_t>(backend);
-    init_desktop_apis();
+    {
+        startup_timeline::phase_t phase{"desktop APIs"};
+        init_desktop_apis();
+    }
 
     /* Somehow GTK requires the tablet_v2 to be advertised pretty early */
     protocols.tablet_v2 = wlr_tablet_v2_create(display);
-    input = std::make_unique<wf::input_manager_t>();
-    seat  = std::make_unique<wf::seat_t>();
+    {
+        startup_timeline::phase_t phase{"input and seat"};
+        input = std::make_unique<wf::input_manager_t>();
+        seat  = std::make_unique<wf::seat_t>();
+    }
 
     protocols.screencopy = wlr_screencopy_manager_v1_create(display);
     protocols.gamma_v1   = wlr_gamma_control_manager_v1_create(display);
@@ -298,8 +307,11 @@ void wf::compositor_core_impl_t::init()
     wf_shell  = wayfire_shell_create(display);
     gtk_shell = wf_gtk_shell_create(display);
 
-    image_io::init();
-    OpenGL::init();
+    {
+        startup_timeline::phase_t phase{"OpenGL"};
+        image_io::init();
+        OpenGL::init();
+    }
 
     init_last_view_tracking();
     this->state = compositor_state_t::START_BACKEND;
@@ -361,6 +373,16 @@ wf::compositor_state_t wf::compositor_core_impl_t::get_current_state()
     return this->state;
 }
 
+wf::thread_pool_t& wf::compositor_core_impl_t::get_thread_pool()
+{
+    if (!thread_pool)
+    {
+        thread_pool = std::make_unique<wf::thread_pool_t>();
+    }
+
+    return *thread_pool;
+}
+
 wlr_seat*wf::compositor_core_impl_t::get_current_seat()
 {
     return seat->seat;
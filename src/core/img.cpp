@@ -1,6 +1,9 @@
 #include <wayfire/util/log.hpp>
 #include "wayfire/img.hpp"
 #include "wayfire/opengl.hpp"
+#include "wayfire/core.hpp"
+#include "wayfire/thread-pool.hpp"
+#include "wayfire/signal-definitions.hpp"
 
 #include <config.h>
 
@@ -12,7 +15,12 @@
 
 #include <stdint.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <mutex>
 #include <unordered_map>
 #include <functional>
 
@@ -20,21 +28,38 @@
 
 namespace image_io
 {
-using Loader = std::function<bool (const char*, GLuint)>;
-using Writer = std::function<void (const char*name, uint8_t*pixels, unsigned long,
-    unsigned long)>;
+/* Loaders decode the file contents into the image and may be called from any
+ * thread */
+using Loader = std::function<bool (std::FILE*, image_t&)>;
+/* Writers encode the pixels with the given compression level (-1 for the
+ * default) and may be called from any thread */
+using Writer = std::function<bool (const char*name, const uint8_t*pixels, int w,
+    int h, int compression_level)>;
 namespace
 {
 std::unordered_map<std::string, Loader> loaders;
 std::unordered_map<std::string, Writer> writers;
+
+/* Cache of decoded images, keyed by the hash and the size of the file
+ * contents. The most recently used image is at the front. */
+struct cache_entry_t
+{
+    uint64_t hash;
+    size_t file_size;
+    std::shared_ptr<const image_t> image;
+};
+
+constexpr size_t MAX_CACHE_BYTES = 64 << 20;
+std::mutex cache_mutex;
+std::list<cache_entry_t> cache;
+size_t cache_bytes = 0;
 }
 
 #ifdef BUILD_WITH_IMAGEIO
 /* All backend functions are taken from the internet.
  * If you want to be credited, contact me */
-bool texture_from_png(const char *filename, GLuint target)
+bool image_from_png(std::FILE *fp, image_t& image)
 {
-    FILE *fp = fopen(filename, "rb");
     int width, height;
     png_byte color_type;
     png_byte bit_depth;
@@ -55,6 +80,8 @@ bool texture_from_png(const char *filename, GLuint target)
 
     if (setjmp(png_jmpbuf(png)))
     {
+        png_destroy_read_struct(&png, &infos, NULL);
+
         return false;
     }
 
@@ -103,34 +130,33 @@ bool texture_from_png(const char *filename, GLuint target)
 
     png_read_update_info(png, infos);
 
-    row_pointers = new png_bytep[height];
-    png_byte *data = new png_byte[height * png_get_rowbytes(png, infos)];
+    image.width  = width;
+    image.height = height;
+    image.format = GL_RGBA;
+    image.pixels.resize(height * png_get_rowbytes(png, infos));
 
+    row_pointers = new png_bytep[height];
     for (int i = 0; i < height; i++)
     {
-        row_pointers[i] = data + i * png_get_rowbytes(png, infos);
+        row_pointers[i] = image.pixels.data() + i * png_get_rowbytes(png, infos);
     }
 
     png_read_image(png, row_pointers);
-    GL_CALL(glTexImage2D(target, 0, GL_RGBA, width, height, 0,
-        GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)data));
 
     png_destroy_read_struct(&png, &infos, NULL);
     delete[] row_pointers;
-    delete[] data;
-
-    fclose(fp);
 
     return true;
 }
 
-void texture_to_png(const char *name, uint8_t *pixels, int w, int h)
+bool texture_to_png(const char *name, const uint8_t *pixels, int w, int h,
+    int compression_level)
 {
     png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr,
         nullptr, nullptr);
     if (!png)
     {
-        return;
+        return false;
     }
 
     png_infop infot = png_create_info_struct(png);
@@ -138,7 +164,7 @@ void texture_to_png(const char *name, uint8_t *pixels, int w, int h)
     {
         png_destroy_write_struct(&png, &infot);
 
-        return;
+        return false;
     }
 
     FILE *fp = fopen(name, "wb");
@@ -146,43 +172,43 @@ void texture_to_png(const char *name, uint8_t *pixels, int w, int h)
     {
         png_destroy_write_struct(&png, &infot);
 
-        return;
+        return false;
     }
 
-    png_init_io(png, fp);
-    png_set_IHDR(png, infot, w, h, 8 /* depth */, PNG_COLOR_TYPE_RGBA,
-        PNG_INTERLACE_NONE,
-        PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-    png_colorp palette =
-        (png_colorp)png_malloc(png, PNG_MAX_PALETTE_LENGTH * sizeof(png_color));
-    if (!palette)
+    if (setjmp(png_jmpbuf(png)))
     {
         fclose(fp);
         png_destroy_write_struct(&png, &infot);
 
-        return;
+        return false;
     }
 
-    png_set_PLTE(png, infot, palette, PNG_MAX_PALETTE_LENGTH);
+    png_init_io(png, fp);
+    if (compression_level >= 0)
+    {
+        png_set_compression_level(png, std::min(compression_level, 9));
+    }
+
+    png_set_IHDR(png, infot, w, h, 8 /* depth */, PNG_COLOR_TYPE_RGBA,
+        PNG_INTERLACE_NONE,
+        PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
     png_write_info(png, infot);
-    png_set_packing(png);
 
-    png_bytepp rows = (png_bytepp)png_malloc(png, h * sizeof(png_bytep));
+    /* The pixels are stored bottom to top, as read from OpenGL. The rows are
+     * streamed to the encoder, so no row array has to be built. */
     for (int i = 0; i < h; ++i)
     {
-        rows[i] = (png_bytep)(pixels + (h - i) * w * 4);
+        png_write_row(png, (png_const_bytep)(pixels + (h - 1 - i) * w * 4));
     }
 
-    png_write_image(png, rows);
     png_write_end(png, infot);
-    png_free(png, palette);
     png_destroy_write_struct(&png, &infot);
-
     fclose(fp);
-    delete[] rows;
+
+    return true;
 }
 
-bool texture_from_jpeg(const char *FileName, GLuint target)
+bool image_from_jpeg(std::FILE *file, image_t& image)
 {
     unsigned long data_size;
     unsigned char *rowptr[1];
@@ -190,24 +216,21 @@ bool texture_from_jpeg(const char *FileName, GLuint target)
     struct jpeg_decompress_struct infot;
     struct jpeg_error_mgr err;
 
-    std::FILE *file = fopen(FileName, "rb");
     infot.err = jpeg_std_error(&err);
     jpeg_create_decompress(&infot);
 
-    if (!file)
-    {
-        LOGE("failed to read JPEG file ", FileName);
-
-        return false;
-    }
-
     jpeg_stdio_src(&infot, file);
     jpeg_read_header(&infot, TRUE);
     jpeg_start_decompress(&infot);
 
     data_size = infot.output_width * infot.output_height * 3;
 
-    jdata = new unsigned char [data_size];
+    image.width  = infot.output_width;
+    image.height = infot.output_height;
+    image.format = GL_RGB;
+    image.pixels.resize(data_size);
+
+    jdata = image.pixels.data();
     while (infot.output_scanline < infot.output_height)
     {
         rowptr[0] = (unsigned char*)jdata + 3 * infot.output_width *
@@ -216,29 +239,69 @@ bool texture_from_jpeg(const char *FileName, GLuint target)
     }
 
     jpeg_finish_decompress(&infot);
-
-    GL_CALL(glTexImage2D(target, 0, GL_RGB,
-        infot.output_width, infot.output_height,
-        0, GL_RGB, GL_UNSIGNED_BYTE, jdata));
-
-    fclose(file);
-    delete[] jdata;
+    jpeg_destroy_decompress(&infot);
 
     return true;
 }
 
 #endif
 
-bool load_from_file(std::string name, GLuint target)
+/* FNV-1a, good enough to tell images apart */
+static uint64_t hash_contents(const std::vector<uint8_t>& contents)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (auto byte : contents)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static std::shared_ptr<const image_t> find_in_cache(uint64_t hash, size_t size)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (auto it = cache.begin(); it != cache.end(); ++it)
+    {
+        if ((it->hash == hash) && (it->file_size == size))
+        {
+            cache.splice(cache.begin(), cache, it);
+
+            return it->image;
+        }
+    }
+
+    return nullptr;
+}
+
+static void add_to_cache(uint64_t hash, size_t size,
+    std::shared_ptr<const image_t> image)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache.push_front({hash, size, image});
+    cache_bytes += image->pixels.size();
+
+    /* Always keep the newest image, even if it alone exceeds the limit */
+    while (cache_bytes > MAX_CACHE_BYTES && cache.size() > 1)
+    {
+        cache_bytes -= cache.back().image->pixels.size();
+        cache.pop_back();
+    }
+}
+
+/* Decode the given file, or take it from the cache. Can be called from any
+ * thread. */
+static std::shared_ptr<const image_t> decode_file(const std::string& name)
 {
     if (access(name.c_str(), F_OK) == -1)
     {
         if (!name.empty())
         {
-            LOGE(__func__, "() cannot access ", name);
+            LOGE("load_from_file() cannot access ", name);
         }
 
-        return false;
+        return nullptr;
     }
 
     int len = name.length();
@@ -247,7 +310,7 @@ bool load_from_file(std::string name, GLuint target)
         LOGE(
             "load_from_file() called with file without extension or with invalid extension!");
 
-        return false;
+        return nullptr;
     }
 
     auto ext = name.substr(len - 3, 3);
@@ -261,11 +324,74 @@ bool load_from_file(std::string name, GLuint target)
     {
         LOGE("load_from_file() called with unsupported extension ", ext);
 
-        return false;
-    } else
+        return nullptr;
+    }
+
+    std::ifstream file(name, std::ios::binary);
+    std::vector<uint8_t> contents{std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>()};
+    if (!file.good() && !file.eof())
+    {
+        LOGE("load_from_file() failed to read ", name);
+
+        return nullptr;
+    }
+
+    uint64_t hash = hash_contents(contents);
+    if (auto cached = find_in_cache(hash, contents.size()))
     {
-        return it->second(name.c_str(), target);
+        return cached;
     }
+
+    std::FILE *fp = fmemopen(contents.data(), contents.size(), "rb");
+    if (!fp)
+    {
+        LOGE("load_from_file() failed to read ", name);
+
+        return nullptr;
+    }
+
+    auto image = std::make_shared<image_t>();
+    bool ok = it->second(fp, *image);
+    std::fclose(fp);
+    if (!ok)
+    {
+        return nullptr;
+    }
+
+    add_to_cache(hash, contents.size(), image);
+
+    return image;
+}
+
+void upload_to_texture(const image_t& image, GLuint target)
+{
+    /* RGB rows are not necessarily 4-byte aligned */
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GL_CALL(glTexImage2D(target, 0, image.format, image.width, image.height,
+        0, image.format, GL_UNSIGNED_BYTE, (GLvoid*)image.pixels.data()));
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
+bool load_from_file(std::string name, GLuint target)
+{
+    auto image = decode_file(name);
+    if (!image)
+    {
+        return false;
+    }
+
+    upload_to_texture(*image, target);
+
+    return true;
+}
+
+void load_from_file_async(std::string name, load_callback_t callback)
+{
+    auto result = std::make_shared<std::shared_ptr<const image_t>>();
+    wf::get_core().get_thread_pool().submit(
+        [=] () { *result = decode_file(name); },
+        [=] () { callback(*result); });
 }
 
 void write_to_file(std::string name, uint8_t *pixels, int w, int h, std::string type)
@@ -277,16 +403,70 @@ void write_to_file(std::string name, uint8_t *pixels, int w, int h, std::string
         LOGE("unsupported image_writer backend");
     } else
     {
-        it->second(name.c_str(), pixels, w, h);
+        it->second(name.c_str(), pixels, w, h, -1);
     }
 }
 
+static void emit_image_written(std::string name, bool success)
+{
+    wf::image_written_signal ev;
+    ev.filename = name;
+    ev.success  = success;
+    wf::get_core().emit_signal("image-written", &ev);
+}
+
+void write_to_file_async(std::string name, std::vector<uint8_t> pixels, int w,
+    int h, std::string type, int compression_level)
+{
+    /* Failures are reported from the event loop too, so that callers always
+     * get the signal after this function returns */
+    auto fail = [=] ()
+    {
+        wf::get_core().get_thread_pool().submit([] () {},
+            [=] () { emit_image_written(name, false); });
+    };
+
+    auto it = writers.find(type);
+    if (it == writers.end())
+    {
+        LOGE("unsupported image_writer backend");
+
+        return fail();
+    }
+
+    if ((int64_t)pixels.size() < 4ll * w * h)
+    {
+        LOGE("write_to_file_async() called with too few pixels for ", name);
+
+        return fail();
+    }
+
+    /* The pixels are moved into the task, which is the only owner */
+    auto writer = it->second;
+    auto data   = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+    auto success = std::make_shared<bool>(false);
+    wf::get_core().get_thread_pool().submit([=] ()
+    {
+        *success = writer(name.c_str(), data->data(), w, h, compression_level);
+        data->clear();
+        data->shrink_to_fit();
+    }, [=] ()
+    {
+        if (!*success)
+        {
+            LOGE("Failed to write image to ", name);
+        }
+
+        emit_image_written(name, *success);
+    });
+}
+
 void init()
 {
     LOGD("init ImageIO");
 #ifdef BUILD_WITH_IMAGEIO
-    loaders["png"] = Loader(texture_from_png);
-    loaders["jpg"] = Loader(texture_from_jpeg);
+    loaders["png"] = Loader(image_from_png);
+    loaders["jpg"] = Loader(image_from_jpeg);
     writers["png"] = Writer(texture_to_png);
 #endif
 }
@@ -0,0 +1,215 @@
+#include <wayfire/layout-transaction.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/output-layout.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/util.hpp>
+
+#include <set>
+
+namespace
+{
+/**
+ * Keeps track of the views which haven't resized after a committed transaction
+ * yet, and of the outputs whose frames are held until they do.
+ *
+ * A view is ready as soon as its client commits a new size. It doesn't have to
+ * match the requested size exactly, since clients may clamp it to their size
+ * hints or round it to their size increments.
+ *
+ * All waiting views share a single transaction, since two transactions which
+ * overlap in time would anyway have to be presented together.
+ */
+class transaction_manager_t : public wf::custom_data_t
+{
+  public:
+    transaction_manager_t()
+    {
+        wf::get_core().output_layout->connect_signal("output-removed",
+            &on_output_removed);
+    }
+
+    ~transaction_manager_t()
+    {
+        release();
+    }
+
+    void commit(const std::vector<std::pair<wayfire_view,
+        wf::geometry_t>>& geometries)
+    {
+        for (auto& [view, geometry] : geometries)
+        {
+            view->set_geometry(geometry);
+
+            auto output = view->get_output();
+            if ((timeout <= 0) || !output || !view->is_mapped() ||
+                (wf::dimensions(view->get_wm_geometry()) ==
+                 wf::dimensions(geometry)))
+            {
+                /* Either nothing to wait for, or the view doesn't need to
+                 * resize, for ex. because it was only moved */
+                stop_waiting(view);
+                continue;
+            }
+
+            if (!waiting.count(view.get()))
+            {
+                view->connect_signal("geometry-changed", &on_view_resized);
+                view->connect_signal("unmapped", &on_view_unmapped);
+            }
+
+            waiting.insert(view.get());
+            if (!held_outputs.count(output))
+            {
+                held_outputs.insert(output);
+                output->render->add_frame_hold(true);
+            }
+        }
+
+        if (waiting.empty())
+        {
+            release();
+        } else if (!timer.is_connected())
+        {
+            timer.set_timeout(timeout, [=] ()
+            {
+                release();
+                return false;
+            });
+        }
+    }
+
+  private:
+    wf::option_wrapper_t<int> timeout{"core/transaction_timeout"};
+
+    std::set<wf::view_interface_t*> waiting;
+    std::set<wf::output_t*> held_outputs;
+    wf::wl_timer timer;
+
+    void stop_waiting(wayfire_view view)
+    {
+        if (waiting.erase(view.get()))
+        {
+            view->disconnect_signal(&on_view_resized);
+            view->disconnect_signal(&on_view_unmapped);
+        }
+    }
+
+    /** Present the new layout, regardless of which views are still waiting */
+    void release()
+    {
+        for (auto& view : waiting)
+        {
+            view->disconnect_signal(&on_view_resized);
+            view->disconnect_signal(&on_view_unmapped);
+        }
+
+        waiting.clear();
+        timer.disconnect();
+
+        auto outputs = std::move(held_outputs);
+        held_outputs.clear();
+        for (auto& output : outputs)
+        {
+            output->render->add_frame_hold(false);
+        }
+    }
+
+    void view_ready(wayfire_view view)
+    {
+        if (!waiting.count(view.get()))
+        {
+            return;
+        }
+
+        stop_waiting(view);
+        if (waiting.empty())
+        {
+            release();
+        }
+    }
+
+    wf::signal_connection_t on_view_resized = [=] (wf::signal_data_t *data)
+    {
+        auto ev = static_cast<wf::view_geometry_changed_signal*>(data);
+
+        /* Moving the view changes its geometry right away, wait until the
+         * client commits a new size */
+        if (wf::dimensions(ev->old_geometry) !=
+            wf::dimensions(ev->view->get_wm_geometry()))
+        {
+            view_ready(ev->view);
+        }
+    };
+
+    wf::signal_connection_t on_view_unmapped = [=] (wf::signal_data_t *data)
+    {
+        view_ready(wf::get_signaled_view(data));
+    };
+
+    wf::signal_connection_t on_output_removed = [=] (wf::signal_data_t *data)
+    {
+        auto output = wf::get_signaled_output(data);
+        if (!held_outputs.erase(output))
+        {
+            return;
+        }
+
+        for (auto it = waiting.begin(); it != waiting.end();)
+        {
+            auto view = *it;
+            ++it;
+            if (view->get_output() == output)
+            {
+                stop_waiting(view->self());
+            }
+        }
+
+        if (waiting.empty())
+        {
+            release();
+        }
+    };
+};
+}
+
+wf::layout_transaction_t::~layout_transaction_t()
+{
+    commit();
+}
+
+void wf::layout_transaction_t::set_geometry(wayfire_view view,
+    wf::geometry_t geometry)
+{
+    for (auto& [pending_view, pending_geometry] : pending)
+    {
+        if (pending_view == view)
+        {
+            pending_geometry = geometry;
+            return;
+        }
+    }
+
+    pending.push_back({view, geometry});
+}
+
+bool wf::layout_transaction_t::empty() const
+{
+    return pending.empty();
+}
+
+void wf::layout_transaction_t::commit()
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    /* Plugins may commit again from the signals emitted by set_geometry(),
+     * so make sure a recursive commit doesn't see the same geometries */
+    auto geometries = std::move(pending);
+    pending.clear();
+    wf::get_core().get_data_safe<transaction_manager_t>()->commit(geometries);
+}
@@ -5,6 +5,190 @@
 #include <wayfire/condition/condition.hpp>
 #include <wayfire/view-access-interface.hpp>
 #include <wayfire/parser/condition_parser.hpp>
+#include <functional>
+#include <unordered_map>
+
+namespace
+{
+using property_t = wf::view_access_interface_t::property_t;
+
+/*
+ * The cheap view properties are packed in a bitmask, which is compared with
+ * the snapshot stored in a cache entry. Title and app-id are compared by their
+ * hashes. They are not tracked with the title-changed and app-id-changed
+ * signals, because handlers of these signals which were connected before the
+ * cache would see stale results.
+ */
+enum state_bits_t : uint32_t
+{
+    STATE_FULLSCREEN  = (1 << 0),
+    STATE_ACTIVATED   = (1 << 1),
+    STATE_MINIMIZED   = (1 << 2),
+    STATE_MAPPED      = (1 << 3),
+    STATE_TILED_SHIFT = 4,
+    STATE_TILED       = (0xf << STATE_TILED_SHIFT),
+    STATE_ROLE_SHIFT  = 8,
+    STATE_ROLE        = (0xf << STATE_ROLE_SHIFT),
+};
+
+uint32_t get_view_state(wayfire_view view)
+{
+    return (view->fullscreen ? STATE_FULLSCREEN : 0) |
+           (view->activated ? STATE_ACTIVATED : 0) |
+           (view->minimized ? STATE_MINIMIZED : 0) |
+           (view->is_mapped() ? STATE_MAPPED : 0) |
+           ((view->tiled_edges << STATE_TILED_SHIFT) & STATE_TILED) |
+           ((view->role << STATE_ROLE_SHIFT) & STATE_ROLE);
+}
+
+/** The properties which a condition read while it was evaluated */
+struct dependencies_t
+{
+    uint32_t state_mask = 0;
+    bool title  = false;
+    bool app_id = false;
+    /* Set if a property was read which can't be tracked */
+    bool volatile_property = false;
+
+    void add(property_t property, wayfire_view view)
+    {
+        switch (property)
+        {
+          case property_t::PROPERTY_APP_ID:
+            app_id = true;
+            break;
+
+          case property_t::PROPERTY_TITLE:
+            title = true;
+            break;
+
+          case property_t::PROPERTY_ROLE:
+            state_mask |= STATE_ROLE;
+            break;
+
+          case property_t::PROPERTY_FULLSCREEN:
+            state_mask |= STATE_FULLSCREEN;
+            break;
+
+          case property_t::PROPERTY_ACTIVATED:
+            state_mask |= STATE_ACTIVATED;
+            break;
+
+          case property_t::PROPERTY_MINIMIZED:
+            state_mask |= STATE_MINIMIZED;
+            break;
+
+          case property_t::PROPERTY_MAPPED:
+            state_mask |= STATE_MAPPED;
+            break;
+
+          case property_t::PROPERTY_TILED_LEFT:
+          case property_t::PROPERTY_TILED_RIGHT:
+          case property_t::PROPERTY_TILED_TOP:
+          case property_t::PROPERTY_TILED_BOTTOM:
+          case property_t::PROPERTY_MAXIMIZED:
+          case property_t::PROPERTY_FLOATING:
+            state_mask |= STATE_TILED;
+            break;
+
+          case property_t::PROPERTY_TYPE:
+            /* The type of toplevel and unmanaged views depends only on the
+             * role, for other views it depends on the layer */
+            state_mask |= STATE_ROLE;
+            if ((view->role != wf::VIEW_ROLE_TOPLEVEL) &&
+                (view->role != wf::VIEW_ROLE_UNMANAGED))
+            {
+                volatile_property = true;
+            }
+
+            break;
+
+          default:
+            volatile_property = true;
+            break;
+        }
+    }
+};
+
+/** An access interface which records the properties that are read */
+class recording_access_interface_t : public wf::access_interface_t
+{
+  public:
+    recording_access_interface_t(wayfire_view view) :
+        view(view), view_access(view)
+    {}
+
+    wf::variant_t get(const std::string& identifier, bool& error) override
+    {
+        auto property = wf::view_access_interface_t::get_property(identifier);
+        if (property == property_t::PROPERTY_UNKNOWN)
+        {
+            dependencies.volatile_property = true;
+            return view_access.get(identifier, error);
+        }
+
+        dependencies.add(property, view);
+        return view_access.get(property, error);
+    }
+
+    wayfire_view view;
+    wf::view_access_interface_t view_access;
+    dependencies_t dependencies;
+};
+
+/**
+ * The cached results of all matchers for a single view.
+ */
+class matcher_cache_t : public wf::custom_data_t
+{
+  public:
+    struct entry_t
+    {
+        uint64_t condition_id;
+        bool result;
+
+        dependencies_t dependencies;
+        uint32_t state;
+        size_t title_hash;
+        size_t app_id_hash;
+    };
+
+    /* Keyed by the matcher. A new matcher at the address of a destroyed one
+     * has a different condition id, so its entry is simply overwritten. */
+    std::unordered_map<const void*, entry_t> entries;
+
+    static size_t hash_title(wayfire_view view)
+    {
+        return std::hash<std::string>{}(view->get_title());
+    }
+
+    static size_t hash_app_id(wayfire_view view)
+    {
+        return std::hash<std::string>{}(view->get_app_id());
+    }
+
+    const entry_t *find(wayfire_view view, const void *matcher,
+        uint64_t condition_id, uint32_t state)
+    {
+        auto it = entries.find(matcher);
+        if (it == entries.end())
+        {
+            return nullptr;
+        }
+
+        auto& entry = it->second;
+        auto& deps  = entry.dependencies;
+        bool valid  = (entry.condition_id == condition_id) &&
+            ((entry.state & deps.state_mask) == (state & deps.state_mask)) &&
+            (!deps.title || (entry.title_hash == hash_title(view))) &&
+            (!deps.app_id || (entry.app_id_hash == hash_app_id(view)));
+
+        return valid ? &entry : nullptr;
+    }
+};
+
+uint64_t next_condition_id = 1;
+}
 
 class wf::view_matcher_t::impl
 {
@@ -14,10 +198,13 @@ class wf::view_matcher_t::impl
     wf::lexer_t lexer;
     wf::condition_parser_t parser;
     std::shared_ptr<wf::condition_t> condition;
+    /* Identifies the current condition in the caches of the views */
+    uint64_t condition_id = 0;
 
     bool try_parse(const std::string& value, const std::string& opt_name)
     {
         lexer.reset(value);
+        condition_id = next_condition_id++;
         try {
             condition = parser.parse(lexer);
 
@@ -104,15 +291,44 @@ void wf::view_matcher_t::set_from_option(
 
 bool wf::view_matcher_t::matches(wayfire_view view)
 {
-    if (this->priv->condition)
+    if (!this->priv->condition)
+    {
+        return false;
+    }
+
+    bool error = false;
+    if (!view)
     {
-        bool ignored = false;
         wf::view_access_interface_t access_interface{view};
+        return this->priv->condition->evaluate(access_interface, error);
+    }
+
+    /* The result is cached until one of the properties that the evaluation
+     * depended on changes */
+    auto cache = view->get_data<matcher_cache_t>();
+    if (!cache)
+    {
+        view->store_data(std::make_unique<matcher_cache_t>());
+        cache = view->get_data<matcher_cache_t>();
+    }
 
-        return this->priv->condition->evaluate(access_interface, ignored);
+    uint32_t state = get_view_state(view);
+    if (auto entry = cache->find(view, priv.get(), priv->condition_id, state))
+    {
+        return entry->result;
+    }
+
+    recording_access_interface_t access_interface{view};
+    bool result = this->priv->condition->evaluate(access_interface, error);
+    if (!error && !access_interface.dependencies.volatile_property)
+    {
+        auto& deps = access_interface.dependencies;
+        cache->entries[priv.get()] = {priv->condition_id, result, deps, state,
+            deps.title ? matcher_cache_t::hash_title(view) : 0,
+            deps.app_id ? matcher_cache_t::hash_app_id(view) : 0};
     }
 
-    return false;
+    return result;
 }
 
 wf::view_matcher_t::~view_matcher_t() = default;
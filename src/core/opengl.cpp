@@ -1,5 +1,6 @@
 #include <wayfire/util/log.hpp>
 #include <map>
+#include <cstdio>
 #include "opengl-priv.hpp"
 #include "wayfire/output.hpp"
 #include "core-impl.hpp"
@@ -91,9 +92,35 @@ GLuint compile_program(std::string vertex_source, std::string frag_source)
     return result_program;
 }
 
+namespace
+{
+bool npot_mipmaps = false;
+}
+
+static bool check_npot_mipmaps()
+{
+    auto version = (const char*)glGetString(GL_VERSION);
+    int major = 0;
+    if (version && (std::sscanf(version, "OpenGL ES %d", &major) == 1) &&
+        (major >= 3))
+    {
+        return true;
+    }
+
+    auto extensions = (const char*)glGetString(GL_EXTENSIONS);
+    return extensions &&
+           std::string(extensions).find("GL_OES_texture_npot") != std::string::npos;
+}
+
+bool supports_npot_mipmaps()
+{
+    return npot_mipmaps;
+}
+
 void init()
 {
     render_begin();
+    npot_mipmaps = check_npot_mipmaps();
     // enable_gl_synchronuous_debug()
     program.compile(default_vertex_shader_source,
         default_fragment_shader_source);
@@ -174,6 +201,12 @@ void render_transformed_texture(wf::texture_t tex,
     }
 
     program.set_active_texture(tex);
+    if (bits & TEXTURE_USE_MIPMAPS)
+    {
+        GL_CALL(glTexParameteri(tex.target, GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR));
+    }
+
     program.attrib_pointer("position", 2, 0, vertexData);
     program.attrib_pointer("uvPosition", 2, 0, coordData);
     program.uniformMatrix4f("MVP", model);
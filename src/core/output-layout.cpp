@@ -12,8 +12,11 @@
 #include "core-impl.hpp"
 
 #include <xf86drmMode.h>
+#include <sys/stat.h>
 #include <sstream>
+#include <cmath>
 #include <cstring>
+#include <deque>
 #include <unordered_set>
 
 #include <wayfire/util/log.hpp>
@@ -241,6 +244,7 @@ struct output_layout_output_t
     wf::option_wrapper_t<wf::output_config::position_t> position_opt;
     wf::option_wrapper_t<double> scale_opt;
     wf::option_wrapper_t<std::string> transform_opt;
+    wf::option_wrapper_t<bool> mirror_keep_aspect_opt;
 
     void initialize_config_options()
     {
@@ -250,6 +254,7 @@ struct output_layout_output_t
         position_opt.load_option(name + "/position");
         scale_opt.load_option(name + "/scale");
         transform_opt.load_option(name + "/transform");
+        mirror_keep_aspect_opt.load_option(name + "/mirror_keep_aspect");
     }
 
     output_layout_output_t(wlr_output *handle)
@@ -570,28 +575,183 @@ struct output_layout_output_t
     wl_listener_wrapper on_frame;
     wlr_output *locked_cursors_on = NULL;
 
-    /** Render the output using texture as source */
-    void render_output(wlr_texture *texture)
+    /* Textures imported from the buffers of the mirrored output. The output
+     * cycles through a few buffers, so we keep a texture for each of them
+     * instead of importing the buffer again every frame. */
+    struct mirror_texture_t
+    {
+        /* dmabufs are identified by the inode of their file descriptor */
+        ino_t inode;
+        wlr_dmabuf_attributes attributes;
+        wlr_texture *texture;
+    };
+
+    static constexpr size_t MAX_MIRROR_TEXTURES = 4;
+    /* The most recently used texture is at the front */
+    std::deque<mirror_texture_t> mirror_textures;
+
+    /* Damage of the mirrored output since our last frame, in its buffer
+     * coordinates */
+    wf::region_t mirrored_damage;
+    bool mirrored_damage_whole = true;
+
+    /* Damage of our last frames, needed for the buffer age, the most recent
+     * frame is at the front */
+    static constexpr size_t MIRROR_DAMAGE_HISTORY = 4;
+    std::deque<wf::region_t> mirror_damage_history;
+
+    void release_mirror_textures()
+    {
+        for (auto& entry : mirror_textures)
+        {
+            wlr_texture_destroy(entry.texture);
+        }
+
+        mirror_textures.clear();
+        mirrored_damage_whole = true;
+        mirror_damage_history.clear();
+    }
+
+    /**
+     * Find or import the texture for the given buffer of the mirrored output.
+     * The attributes are consumed.
+     */
+    wlr_texture *get_mirror_texture(wlr_dmabuf_attributes& attributes)
+    {
+        struct stat st;
+        if (fstat(attributes.fd[0], &st) == 0)
+        {
+            for (auto it = mirror_textures.begin(); it != mirror_textures.end();
+                 ++it)
+            {
+                auto& cached = it->attributes;
+                if ((it->inode == st.st_ino) &&
+                    (cached.width == attributes.width) &&
+                    (cached.height == attributes.height) &&
+                    (cached.format == attributes.format) &&
+                    (cached.modifier == attributes.modifier))
+                {
+                    auto entry = *it;
+                    mirror_textures.erase(it);
+                    mirror_textures.push_front(entry);
+                    wlr_dmabuf_attributes_finish(&attributes);
+
+                    return entry.texture;
+                }
+            }
+        } else
+        {
+            st.st_ino = 0;
+        }
+
+        auto texture = wlr_texture_from_dmabuf(get_core().renderer, &attributes);
+        if (texture && st.st_ino)
+        {
+            mirror_texture_t entry;
+            entry.inode = st.st_ino;
+            entry.attributes = attributes;
+            entry.texture    = texture;
+            mirror_textures.push_front(entry);
+            if (mirror_textures.size() > MAX_MIRROR_TEXTURES)
+            {
+                wlr_texture_destroy(mirror_textures.back().texture);
+                mirror_textures.pop_back();
+            }
+
+            /* The new buffer may contain anything */
+            mirrored_damage_whole = true;
+        }
+
+        wlr_dmabuf_attributes_finish(&attributes);
+
+        return texture;
+    }
+
+    /**
+     * Calculate the box on our output where the mirrored contents are shown,
+     * optionally preserving their aspect ratio.
+     */
+    wlr_box get_mirror_box(int source_width, int source_height)
+    {
+        wlr_box box = {0, 0, handle->width, handle->height};
+        if (!mirror_keep_aspect_opt || (source_width <= 0) ||
+            (source_height <= 0))
+        {
+            return box;
+        }
+
+        double scale = std::min(1.0 * handle->width / source_width,
+            1.0 * handle->height / source_height);
+        box.width  = std::round(source_width * scale);
+        box.height = std::round(source_height * scale);
+        box.x = (handle->width - box.width) / 2;
+        box.y = (handle->height - box.height) / 2;
+
+        return box;
+    }
+
+    /** Render the damaged parts of the output using texture as source */
+    void render_output(wlr_texture *texture, const wlr_box& geometry,
+        const wf::region_t& damage)
     {
         auto renderer = get_core().renderer;
-        wlr_output_attach_render(handle, NULL);
         wlr_renderer_begin(renderer, handle->width, handle->height);
 
-        /* Project a box filling the whole screen */
+        /* Project the box showing the mirrored output */
         float projection[9], box[9];
         wlr_matrix_projection(projection, handle->width, handle->height,
             WL_OUTPUT_TRANSFORM_NORMAL);
-
-        wlr_box geometry = {0, 0, handle->width, handle->height};
         wlr_matrix_project_box(box, &geometry, WL_OUTPUT_TRANSFORM_NORMAL,
             0.0, projection);
 
-        wlr_render_texture_with_matrix(renderer, texture, box, 1.0);
+        for (const auto& rect : damage)
+        {
+            wlr_box scissor = wlr_box_from_pixman_box(rect);
+            wlr_renderer_scissor(renderer, &scissor);
+            static const float black[4] = {0.0, 0.0, 0.0, 1.0};
+            wlr_renderer_clear(renderer, black);
+            wlr_render_texture_with_matrix(renderer, texture, box, 1.0);
+        }
+
+        wlr_renderer_scissor(renderer, NULL);
         wlr_renderer_end(renderer);
-        wlr_output_commit(handle);
     }
 
-    /* Load output contents and render them */
+    /**
+     * Map the damage of the mirrored output to our output.
+     *
+     * @param source_width, source_height The size of the mirrored buffer.
+     * @param y_inverted Whether the mirrored buffer is y-inverted.
+     * @param geometry The box where the mirrored buffer is shown.
+     */
+    wf::region_t map_mirrored_damage(int source_width, int source_height,
+        bool y_inverted, const wlr_box& geometry)
+    {
+        wf::region_t result;
+        const double scale_x = 1.0 * geometry.width / source_width;
+        const double scale_y = 1.0 * geometry.height / source_height;
+        for (const auto& rect : mirrored_damage)
+        {
+            int y1 = rect.y1, y2 = rect.y2;
+            if (y_inverted)
+            {
+                y1 = source_height - rect.y2;
+                y2 = source_height - rect.y1;
+            }
+
+            int x1 = std::floor(rect.x1 * scale_x) + geometry.x;
+            int x2 = std::ceil(rect.x2 * scale_x) + geometry.x;
+            y1 = std::floor(y1 * scale_y) + geometry.y;
+            y2 = std::ceil(y2 * scale_y) + geometry.y;
+
+            /* Leave a margin for the texture filtering */
+            result |= wlr_box{x1 - 1, y1 - 1, x2 - x1 + 2, y2 - y1 + 2};
+        }
+
+        return result;
+    }
+
+    /* Load output contents and render the damaged parts */
     void handle_frame()
     {
         auto wo = get_core().output_layout->find_output(
@@ -613,13 +773,85 @@ struct output_layout_output_t
         }
 
         /* We export the output to mirror from to a dmabuf, then create
-         * a texture from this and use it to render "our" output */
-        auto texture = wlr_texture_from_dmabuf(
-            get_core().renderer, &attributes);
-        render_output(texture);
+         * a texture from this (or reuse the one we have created for the same
+         * buffer before) and use it to render "our" output */
+        int source_width  = attributes.width;
+        int source_height = attributes.height;
+        bool y_inverted   = attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT;
+        auto texture = get_mirror_texture(attributes);
+        if (!texture)
+        {
+            LOGE("Failed importing mirrored output contents from ", wo->handle);
 
-        wlr_texture_destroy(texture);
-        wlr_dmabuf_attributes_finish(&attributes);
+            return;
+        }
+
+        wlr_box full_box = {0, 0, handle->width, handle->height};
+        auto geometry    = get_mirror_box(source_width, source_height);
+
+        wf::region_t frame_damage;
+        if (mirrored_damage_whole)
+        {
+            frame_damage = full_box;
+        } else
+        {
+            frame_damage = map_mirrored_damage(source_width, source_height,
+                y_inverted, geometry) & geometry;
+        }
+
+        int buffer_age;
+        if (!wlr_output_attach_render(handle, &buffer_age))
+        {
+            return;
+        }
+
+        /* The current buffer also misses the damage of the frames since it
+         * was last shown */
+        wf::region_t repaint = frame_damage;
+        if ((buffer_age <= 0) ||
+            (buffer_age - 1 > (int)mirror_damage_history.size()))
+        {
+            repaint = full_box;
+        } else
+        {
+            for (int i = 0; i < buffer_age - 1; i++)
+            {
+                repaint |= mirror_damage_history[i];
+            }
+        }
+
+        mirror_damage_history.push_front(frame_damage);
+        if (mirror_damage_history.size() > MIRROR_DAMAGE_HISTORY)
+        {
+            mirror_damage_history.pop_back();
+        }
+
+        mirrored_damage.clear();
+        mirrored_damage_whole = false;
+
+        render_output(texture, geometry, repaint);
+        wlr_output_set_damage(handle, frame_damage.to_pixman());
+        wlr_output_commit(handle);
+    }
+
+    /** Accumulate the damage of a frame of the mirrored output */
+    void handle_mirrored_precommit(wlr_output *mirrored)
+    {
+        if (!(mirrored->pending.committed & WLR_OUTPUT_STATE_BUFFER))
+        {
+            return;
+        }
+
+        if (mirrored->pending.committed & WLR_OUTPUT_STATE_DAMAGE)
+        {
+            mirrored_damage |= wf::region_t{&mirrored->pending.damage};
+        } else
+        {
+            mirrored_damage_whole = true;
+        }
+
+        /* The mirrored output was repainted, schedule repaint for us as well */
+        wlr_output_schedule_frame(handle);
     }
 
     void set_enabled(bool enabled)
@@ -672,12 +904,11 @@ struct output_layout_output_t
         wlr_output_lock_software_cursors(wo->handle, true);
         locked_cursors_on = wo->handle;
 
+        release_mirror_textures();
         wlr_output_schedule_frame(handle);
         on_mirrored_frame.set_callback([=] (void*)
         {
-            /* The mirrored output was repainted, schedule repaint
-             * for us as well */
-            wlr_output_schedule_frame(handle);
+            handle_mirrored_precommit(wo->handle);
         });
         on_mirrored_frame.connect(&wo->handle->events.precommit);
 
@@ -695,6 +926,7 @@ struct output_layout_output_t
 
         on_mirrored_frame.disconnect();
         on_frame.disconnect();
+        release_mirror_textures();
     }
 
     wf::dimensions_t get_effective_size()
@@ -0,0 +1,170 @@
+#include "startup-timeline.hpp"
+#include <wayfire/util/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct event_t
+{
+    std::string name;
+    wf::startup_timeline::clock_t::time_point begin, end;
+    int thread;
+};
+
+struct timeline_t
+{
+    /* Approximately the start of the process */
+    wf::startup_timeline::clock_t::time_point origin =
+        wf::startup_timeline::clock_t::now();
+    std::thread::id main_thread = std::this_thread::get_id();
+
+    std::atomic<bool> finished{false};
+
+    std::mutex mutex;
+    std::vector<event_t> events;
+    /* Threads are numbered in the order they first record an event, the main
+     * thread is always 0 */
+    std::map<std::thread::id, int> thread_index;
+
+    int get_thread_index()
+    {
+        auto id = std::this_thread::get_id();
+        if (id == main_thread)
+        {
+            return 0;
+        }
+
+        auto it = thread_index.find(id);
+        if (it == thread_index.end())
+        {
+            int index = thread_index.size() + 1;
+            it = thread_index.emplace(id, index).first;
+        }
+
+        return it->second;
+    }
+};
+
+timeline_t timeline;
+
+int64_t to_us(wf::startup_timeline::clock_t::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+std::string escape_json(const std::string& str)
+{
+    std::string result;
+    for (char c : str)
+    {
+        if ((c == '"') || (c == '\\'))
+        {
+            result += '\\';
+        }
+
+        result += c;
+    }
+
+    return result;
+}
+
+void write_trace(const std::string& path, const std::vector<event_t>& events)
+{
+    std::ofstream out(path);
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        auto& ev = events[i];
+        out << (i ? "," : "") << "\n{\"name\":\"" << escape_json(ev.name) <<
+            "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ev.thread <<
+            ",\"ts\":" << to_us(ev.begin - timeline.origin) <<
+            ",\"dur\":" << to_us(ev.end - ev.begin) << "}";
+    }
+
+    out << "\n]}\n";
+    if (!out)
+    {
+        LOGE("Failed to write startup trace to ", path);
+    }
+}
+}
+
+namespace wf
+{
+namespace startup_timeline
+{
+void record(const std::string& name, clock_t::time_point begin,
+    clock_t::time_point end)
+{
+    if (timeline.finished)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(timeline.mutex);
+    if (!timeline.finished)
+    {
+        timeline.events.push_back({name, begin, end,
+            timeline.get_thread_index()});
+    }
+}
+
+phase_t::phase_t(std::string name) : name(std::move(name))
+{
+    begin = clock_t::now();
+}
+
+phase_t::~phase_t()
+{
+    record(name, begin, clock_t::now());
+}
+
+void finish()
+{
+    /* Called every frame, so check without taking the lock first */
+    if (timeline.finished)
+    {
+        return;
+    }
+
+    std::vector<event_t> events;
+    {
+        std::lock_guard<std::mutex> lock(timeline.mutex);
+        if (timeline.finished)
+        {
+            return;
+        }
+
+        timeline.finished = true;
+        std::swap(events, timeline.events);
+    }
+
+    auto now = clock_t::now();
+    events.push_back({"first frame", now, now, 0});
+    std::stable_sort(events.begin(), events.end(),
+        [] (const event_t& a, const event_t& b) { return a.begin < b.begin; });
+
+    LOGI("Startup took ", to_us(now - timeline.origin) / 1000,
+        "ms until the first frame");
+    for (auto& ev : events)
+    {
+        LOGD("Startup: ", ev.name, " at ", to_us(ev.begin - timeline.origin) / 1000,
+            "ms took ", to_us(ev.end - ev.begin) / 1000.0, "ms",
+            ev.thread ? " (worker " + std::to_string(ev.thread) + ")" : "");
+    }
+
+    if (char *trace_path = getenv("WAYFIRE_STARTUP_TRACE"))
+    {
+        write_trace(trace_path, events);
+    }
+}
+}
+}
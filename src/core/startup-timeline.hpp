@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace wf
+{
+/**
+ * A profiler for the startup of the compositor. Phases of core initialization
+ * and the loading of each plugin are recorded until the first frame is shown.
+ *
+ * Afterwards, a summary is written to the log, and if the environment
+ * variable WAYFIRE_STARTUP_TRACE is set, the whole timeline is written to the
+ * file it names, in the Chrome trace event format (viewable in
+ * chrome://tracing or Perfetto).
+ */
+namespace startup_timeline
+{
+using clock_t = std::chrono::steady_clock;
+
+/**
+ * Record a phase which ran from begin to end on the calling thread.
+ * Thread-safe. Does nothing after the timeline has been finished.
+ */
+void record(const std::string& name, clock_t::time_point begin,
+    clock_t::time_point end);
+
+/** Record the time from the creation to the destruction of the phase. */
+class phase_t
+{
+  public:
+    phase_t(std::string name);
+    ~phase_t();
+
+  private:
+    std::string name;
+    clock_t::time_point begin;
+};
+
+/**
+ * Finish the timeline, write the summary and the trace file. Called when the
+ * first frame has been shown, subsequent calls do nothing.
+ */
+void finish();
+}
+}
@@ -0,0 +1,309 @@
+#include <wayfire/thread-pool.hpp>
+#include <wayfire/core.hpp>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class wf::thread_pool_t::impl
+{
+  public:
+    struct worker_queue_t
+    {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue_t>> queues;
+    std::vector<std::thread> workers;
+
+    /* Used by idle workers to wait for new tasks */
+    std::mutex sleep_mutex;
+    std::condition_variable wakeup;
+    /* Number of queued tasks which haven't been picked up yet. It is
+     * incremented with sleep_mutex held, so that wakeups are not lost. */
+    std::atomic<int> pending{0};
+    bool stopping = false;
+
+    std::atomic<uint32_t> next_queue{0};
+
+    /* Completions of finished tasks, which wait to be run on the main thread.
+     * The event fd wakes up the event loop when new completions are queued. */
+    std::mutex completion_mutex;
+    std::vector<task_t> completions;
+    int completion_fd = -1;
+    wl_event_source *completion_source = nullptr;
+
+    impl(int num_workers)
+    {
+        for (int i = 0; i < num_workers; i++)
+        {
+            queues.push_back(std::make_unique<worker_queue_t>());
+        }
+
+        for (int i = 0; i < num_workers; i++)
+        {
+            workers.emplace_back([=] () { worker_loop(i); });
+        }
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+
+        wakeup.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        if (completion_source)
+        {
+            wl_event_source_remove(completion_source);
+        }
+
+        if (completion_fd >= 0)
+        {
+            close(completion_fd);
+        }
+    }
+
+    /** Make sure the event loop listens for completions */
+    void init_completions()
+    {
+        if (completion_fd >= 0)
+        {
+            return;
+        }
+
+        completion_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        completion_source = wl_event_loop_add_fd(wf::get_core().ev_loop,
+            completion_fd, WL_EVENT_READABLE, handle_completions, this);
+    }
+
+    /** Queue a completion, can be called from any thread */
+    void push_completion(task_t completion)
+    {
+        {
+            std::lock_guard<std::mutex> lock(completion_mutex);
+            completions.push_back(std::move(completion));
+        }
+
+        uint64_t one = 1;
+        if (write(completion_fd, &one, sizeof(one)) < 0)
+        {
+            /* The counter is already non-zero, so the loop wakes up anyway */
+        }
+    }
+
+    static int handle_completions(int fd, uint32_t mask, void *data)
+    {
+        auto self = static_cast<impl*>(data);
+
+        uint64_t count;
+        if (read(fd, &count, sizeof(count)) < 0)
+        {
+            /* Spurious wakeup, nothing to read */
+        }
+
+        std::vector<task_t> ready;
+        {
+            std::lock_guard<std::mutex> lock(self->completion_mutex);
+            std::swap(ready, self->completions);
+        }
+
+        for (auto& completion : ready)
+        {
+            completion();
+        }
+
+        return 0;
+    }
+
+    void push(task_t task)
+    {
+        auto& queue = *queues[next_queue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            ++pending;
+        }
+
+        wakeup.notify_one();
+    }
+
+    /**
+     * Take the oldest task from the worker's own queue, or if it is empty,
+     * steal the newest task from the queue of another worker.
+     */
+    bool try_pop(int index, task_t& task)
+    {
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            auto& queue = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+
+            if (i == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+
+            --pending;
+            return true;
+        }
+
+        return false;
+    }
+
+    void worker_loop(int index)
+    {
+        while (true)
+        {
+            task_t task;
+            if (try_pop(index, task))
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wakeup.wait(lock, [=] () { return stopping || pending > 0; });
+            if (stopping && (pending == 0))
+            {
+                return;
+            }
+        }
+    }
+};
+
+wf::thread_pool_t::thread_pool_t(int num_workers)
+{
+    if (num_workers < 0)
+    {
+        num_workers = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+
+    priv = std::make_unique<impl>(num_workers);
+}
+
+wf::thread_pool_t::~thread_pool_t() = default;
+
+int wf::thread_pool_t::get_num_workers() const
+{
+    return priv->workers.size();
+}
+
+void wf::thread_pool_t::submit(task_t task)
+{
+    if (priv->workers.empty())
+    {
+        task();
+        return;
+    }
+
+    priv->push(std::move(task));
+}
+
+void wf::thread_pool_t::submit(task_t task, task_t completion)
+{
+    priv->init_completions();
+    auto run = [=, pool = priv.get()] ()
+    {
+        task();
+        pool->push_completion(completion);
+    };
+
+    if (priv->workers.empty())
+    {
+        run();
+        return;
+    }
+
+    priv->push(std::move(run));
+}
+
+void wf::thread_pool_t::parallel_for(int begin, int end, int grain_size,
+    const std::function<void(int, int)>& func)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    grain_size = std::max(grain_size, 1);
+    const int num_chunks = (end - begin + grain_size - 1) / grain_size;
+    if ((num_chunks == 1) || priv->workers.empty())
+    {
+        func(begin, end);
+        return;
+    }
+
+    /* Chunks are claimed dynamically by the calling thread and by the helper
+     * tasks, so that a slow thread doesn't hold back the others. The state is
+     * shared, because helpers which find no more chunks may still be running
+     * after this function returns. */
+    struct state_t
+    {
+        std::function<void(int, int)> func;
+        std::atomic<int> next_chunk{0};
+        std::atomic<int> chunks_left;
+
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    auto state = std::make_shared<state_t>();
+    state->func = func;
+    state->chunks_left = num_chunks;
+
+    auto run_chunks = [=] ()
+    {
+        int chunk;
+        while ((chunk = state->next_chunk++) < num_chunks)
+        {
+            int chunk_begin = begin + chunk * grain_size;
+            state->func(chunk_begin, std::min(end, chunk_begin + grain_size));
+
+            if (--state->chunks_left == 0)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    const int num_helpers = std::min(num_chunks - 1, get_num_workers());
+    for (int i = 0; i < num_helpers; i++)
+    {
+        priv->push(run_chunks);
+    }
+
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [=] () { return state->chunks_left == 0; });
+}
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 
 namespace wf
 {
@@ -18,7 +19,48 @@ view_access_interface_t::view_access_interface_t(wayfire_view view) : _view(view
 view_access_interface_t::~view_access_interface_t()
 {}
 
+view_access_interface_t::property_t view_access_interface_t::get_property(
+    const std::string & identifier)
+{
+    static const std::unordered_map<std::string, property_t> properties = {
+        {"app_id", PROPERTY_APP_ID},
+        {"title", PROPERTY_TITLE},
+        {"role", PROPERTY_ROLE},
+        {"fullscreen", PROPERTY_FULLSCREEN},
+        {"activated", PROPERTY_ACTIVATED},
+        {"minimized", PROPERTY_MINIMIZED},
+        {"visible", PROPERTY_VISIBLE},
+        {"focusable", PROPERTY_FOCUSABLE},
+        {"mapped", PROPERTY_MAPPED},
+        {"tiled-left", PROPERTY_TILED_LEFT},
+        {"tiled-right", PROPERTY_TILED_RIGHT},
+        {"tiled-top", PROPERTY_TILED_TOP},
+        {"tiled-bottom", PROPERTY_TILED_BOTTOM},
+        {"maximized", PROPERTY_MAXIMIZED},
+        {"floating", PROPERTY_FLOATING},
+        {"type", PROPERTY_TYPE},
+    };
+
+    auto it = properties.find(identifier);
+    return it == properties.end() ? PROPERTY_UNKNOWN : it->second;
+}
+
 variant_t view_access_interface_t::get(const std::string & identifier, bool & error)
+{
+    auto property = get_property(identifier);
+    if (property == PROPERTY_UNKNOWN)
+    {
+        error = false;
+        std::cerr << "View access interface: Get operation triggered to" <<
+            " unsupported view property " << identifier << std::endl;
+
+        return std::string("");
+    }
+
+    return get(property, error);
+}
+
+variant_t view_access_interface_t::get(property_t property, bool & error)
 {
     variant_t out = std::string(""); // Default to empty string as output.
     error = false; // Assume things will go well.
@@ -31,14 +73,17 @@ variant_t view_access_interface_t::get(const std::string & identifier, bool & er
         return out;
     }
 
-    if (identifier == "app_id")
+    switch (property)
     {
+      case PROPERTY_APP_ID:
         out = _view->get_app_id();
-    } else if (identifier == "title")
-    {
+        break;
+
+      case PROPERTY_TITLE:
         out = _view->get_title();
-    } else if (identifier == "role")
-    {
+        break;
+
+      case PROPERTY_ROLE:
         switch (_view->role)
         {
           case VIEW_ROLE_TOPLEVEL:
@@ -60,44 +105,58 @@ variant_t view_access_interface_t::get(const std::string & identifier, bool & er
             error = true;
             break;
         }
-    } else if (identifier == "fullscreen")
-    {
+
+        break;
+
+      case PROPERTY_FULLSCREEN:
         out = _view->fullscreen;
-    } else if (identifier == "activated")
-    {
+        break;
+
+      case PROPERTY_ACTIVATED:
         out = _view->activated;
-    } else if (identifier == "minimized")
-    {
+        break;
+
+      case PROPERTY_MINIMIZED:
         out = _view->minimized;
-    } else if (identifier == "visible")
-    {
+        break;
+
+      case PROPERTY_VISIBLE:
         out = _view->is_visible();
-    } else if (identifier == "focusable")
-    {
+        break;
+
+      case PROPERTY_FOCUSABLE:
         out = _view->is_focuseable();
-    } else if (identifier == "mapped")
-    {
+        break;
+
+      case PROPERTY_MAPPED:
         out = _view->is_mapped();
-    } else if (identifier == "tiled-left")
-    {
+        break;
+
+      case PROPERTY_TILED_LEFT:
         out = (_view->tiled_edges & WLR_EDGE_LEFT) > 0;
-    } else if (identifier == "tiled-right")
-    {
+        break;
+
+      case PROPERTY_TILED_RIGHT:
         out = (_view->tiled_edges & WLR_EDGE_RIGHT) > 0;
-    } else if (identifier == "tiled-top")
-    {
+        break;
+
+      case PROPERTY_TILED_TOP:
         out = (_view->tiled_edges & WLR_EDGE_TOP) > 0;
-    } else if (identifier == "tiled-bottom")
-    {
+        break;
+
+      case PROPERTY_TILED_BOTTOM:
         out = (_view->tiled_edges & WLR_EDGE_BOTTOM) > 0;
-    } else if (identifier == "maximized")
-    {
+        break;
+
+      case PROPERTY_MAXIMIZED:
         out = _view->tiled_edges == TILED_EDGES_ALL;
-    } else if (identifier == "floating")
-    {
+        break;
+
+      case PROPERTY_FLOATING:
         out = _view->tiled_edges == 0;
-    } else if (identifier == "type")
-    {
+        break;
+
+      case PROPERTY_TYPE:
         do {
             if (_view->role == VIEW_ROLE_TOPLEVEL)
             {
@@ -142,10 +201,11 @@ variant_t view_access_interface_t::get(const std::string & identifier, bool & er
 
             out = std::string("unknown");
         } while (false);
-    } else
-    {
-        std::cerr << "View access interface: Get operation triggered to" <<
-            " unsupported view property " << identifier << std::endl;
+
+        break;
+
+      default:
+        break;
     }
 
     return out;
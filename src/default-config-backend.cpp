@@ -5,6 +5,7 @@
 #include <wayfire/config-backend.hpp>
 #include <wayfire/plugin.hpp>
 #include <wayfire/core.hpp>
+#include "metadata-cache.hpp"
 
 #include <sys/inotify.h>
 #include <unistd.h>
@@ -12,27 +13,85 @@
 #define INOT_BUF_SIZE (1024 * sizeof(inotify_event))
 static char buf[INOT_BUF_SIZE];
 
+/* Editors and config tools often write the file in several steps (truncate,
+ * write, rename), so the reload waits until the events have settled. */
+#define RELOAD_DEBOUNCE_MS 100
 
 static std::string config_dir, config_file;
 wf::config::config_manager_t *cfg_manager;
+static wl_event_source *reload_timer;
 
-
-static void reload_config(int fd)
+static void add_watches(int fd)
 {
-    wf::config::load_configuration_options_from_file(*cfg_manager, config_file);
     inotify_add_watch(fd, config_dir.c_str(), IN_CREATE);
     inotify_add_watch(fd, config_file.c_str(), IN_MODIFY);
 }
 
-static int handle_config_updated(int fd, uint32_t mask, void *data)
+/**
+ * Parse the config file into a copy of the current configuration, and copy
+ * only the changed values back. This way, updated handlers run only for
+ * options which actually changed.
+ *
+ * @return The number of changed options and sections.
+ */
+static int reload_config()
+{
+    wf::config::config_manager_t shadow;
+    for (auto& section : cfg_manager->get_all_sections())
+    {
+        shadow.merge_section(section->clone_with_name(section->get_name()));
+    }
+
+    wf::config::load_configuration_options_from_file(shadow, config_file);
+
+    int changed = 0;
+    for (auto& section : shadow.get_all_sections())
+    {
+        auto live_section = cfg_manager->get_section(section->get_name());
+        if (!live_section)
+        {
+            cfg_manager->merge_section(section);
+            ++changed;
+            continue;
+        }
+
+        for (auto& opt : section->get_registered_options())
+        {
+            auto live_opt = live_section->get_option_or(opt->get_name());
+            if (!live_opt)
+            {
+                live_section->register_new_option(opt);
+                ++changed;
+            } else if (live_opt->get_value_str() != opt->get_value_str())
+            {
+                live_opt->set_value_str(opt->get_value_str());
+                ++changed;
+            }
+        }
+    }
+
+    return changed;
+}
+
+static int handle_reload_timeout(void *data)
 {
-    LOGD("Reloading configuration file");
+    add_watches((int)(intptr_t)data);
+
+    int changed = reload_config();
+    LOGD("Reloaded configuration file, ", changed, " changes");
+    if (changed > 0)
+    {
+        wf::get_core().emit_signal("reload-config", nullptr);
+    }
 
+    return 0;
+}
+
+static int handle_config_updated(int fd, uint32_t mask, void *data)
+{
     /* read, but don't use */
     read(fd, buf, INOT_BUF_SIZE);
-    reload_config(fd);
-
-    wf::get_core().emit_signal("reload-config", nullptr);
+    wl_event_source_timer_update(reload_timer, RELOAD_DEBOUNCE_MS);
 
     return 0;
 }
@@ -41,6 +100,29 @@ namespace wf
 {
 class dynamic_ini_config_t : public wf::config_backend_t
 {
+    /**
+     * Load the option metadata from the cache, or if it is stale, parse it
+     * from the XML files and the system defaults and refresh the cache.
+     */
+    void load_metadata(config::config_manager_t& config)
+    {
+        const std::string sysconf = SYSCONFDIR "/wayfire/defaults.ini";
+        auto xmldirs   = get_xml_dirs();
+        auto cache     = metadata_cache::get_default_path();
+        uint64_t key   = metadata_cache::compute_key(xmldirs, sysconf);
+
+        if (metadata_cache::load(cache, key, config))
+        {
+            LOGD("Loaded option metadata from ", cache);
+            return;
+        }
+
+        /* Without a user config, build_configuration() gives just the
+         * metadata with the system defaults applied */
+        config = wf::config::build_configuration(xmldirs, sysconf, "");
+        metadata_cache::save(cache, key, config);
+    }
+
   public:
     void init(wl_display *display, config::config_manager_t& config,
         const std::string& cfg_file) override
@@ -62,14 +144,17 @@ class dynamic_ini_config_t : public wf::config_backend_t
         }
 
         LOGI("Using config file: ", config_file.c_str());
-        config = wf::config::build_configuration(
-            get_xml_dirs(), SYSCONFDIR "/wayfire/defaults.ini", config_file);
+        load_metadata(config);
+        wf::config::load_configuration_options_from_file(config, config_file);
 
         int inotify_fd = inotify_init1(IN_CLOEXEC);
-        reload_config(inotify_fd);
+        add_watches(inotify_fd);
 
-        wl_event_loop_add_fd(wl_display_get_event_loop(display),
-            inotify_fd, WL_EVENT_READABLE, handle_config_updated, NULL);
+        auto loop = wl_display_get_event_loop(display);
+        reload_timer = wl_event_loop_add_timer(loop, handle_reload_timeout,
+            (void*)(intptr_t)inotify_fd);
+        wl_event_loop_add_fd(loop, inotify_fd, WL_EVENT_READABLE,
+            handle_config_updated, NULL);
     }
 };
 }
@@ -15,6 +15,7 @@
 #include "wayfire/config-backend.hpp"
 #include "output/plugin-loader.hpp"
 #include "core/core-impl.hpp"
+#include "core/startup-timeline.hpp"
 #include "wayfire/output.hpp"
 
 wf_runtime_config runtime_config;
@@ -280,7 +281,12 @@ int main(int argc, char *argv[])
 
     LOGD("Using configuration backend: ", config_backend);
     core.config_backend = std::unique_ptr<wf::config_backend_t>(backend);
-    core.config_backend->init(display, core.config, config_file);
+    {
+        wf::startup_timeline::phase_t phase{"config backend"};
+        core.config_backend->init(display, core.config, config_file);
+    }
+
+    wf::preload_plugins();
     core.init();
 
     auto socket = choose_socket(core.display);
@@ -293,13 +299,17 @@ int main(int argc, char *argv[])
 
     core.wayland_display = socket.value();
     LOGI("Using socket name ", core.wayland_display);
-    if (!wlr_backend_start(core.backend))
     {
-        LOGE("Failed to initialize backend, exiting");
-        wlr_backend_destroy(core.backend);
-        wl_display_destroy(core.display);
+        /* Outputs, and with them plugins, are created here */
+        wf::startup_timeline::phase_t phase{"backend start"};
+        if (!wlr_backend_start(core.backend))
+        {
+            LOGE("Failed to initialize backend, exiting");
+            wlr_backend_destroy(core.backend);
+            wl_display_destroy(core.display);
 
-        return -1;
+            return -1;
+        }
     }
 
     core.post_init();
@@ -0,0 +1,491 @@
+#include "metadata-cache.hpp"
+#include "wayfire/debug.hpp"
+
+#include <wayfire/config/types.hpp>
+#include <wayfire/config/option.hpp>
+#include <wayfire/config/section.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+/* Bump whenever the format of the file changes */
+constexpr uint32_t CACHE_VERSION = 1;
+constexpr char CACHE_MAGIC[4] = {'W', 'F', 'M', 'C'};
+
+/* The type of each option is stored as one of these tags */
+enum option_tag_t : uint8_t
+{
+    TAG_INT,
+    TAG_DOUBLE,
+    TAG_BOOL,
+    TAG_STRING,
+    TAG_COLOR,
+    TAG_KEY,
+    TAG_BUTTON,
+    TAG_GESTURE,
+    TAG_ACTIVATOR,
+    TAG_OUTPUT_MODE,
+    TAG_OUTPUT_POSITION,
+    TAG_COUNT,
+};
+
+template<class Type>
+struct type_t
+{
+    using type = Type;
+};
+
+/** Call cb with type_t<T>, where T is the option type of the given tag */
+template<class Callback>
+bool with_option_type(uint8_t tag, Callback&& cb)
+{
+    switch (tag)
+    {
+      case TAG_INT:
+        cb(type_t<int>{});
+        return true;
+
+      case TAG_DOUBLE:
+        cb(type_t<double>{});
+        return true;
+
+      case TAG_BOOL:
+        cb(type_t<bool>{});
+        return true;
+
+      case TAG_STRING:
+        cb(type_t<std::string>{});
+        return true;
+
+      case TAG_COLOR:
+        cb(type_t<wf::color_t>{});
+        return true;
+
+      case TAG_KEY:
+        cb(type_t<wf::keybinding_t>{});
+        return true;
+
+      case TAG_BUTTON:
+        cb(type_t<wf::buttonbinding_t>{});
+        return true;
+
+      case TAG_GESTURE:
+        cb(type_t<wf::touchgesture_t>{});
+        return true;
+
+      case TAG_ACTIVATOR:
+        cb(type_t<wf::activatorbinding_t>{});
+        return true;
+
+      case TAG_OUTPUT_MODE:
+        cb(type_t<wf::output_config::mode_t>{});
+        return true;
+
+      case TAG_OUTPUT_POSITION:
+        cb(type_t<wf::output_config::position_t>{});
+        return true;
+
+      default:
+        return false;
+    }
+}
+
+template<class Type>
+constexpr bool has_bounds = std::is_same<Type, int>::value ||
+    std::is_same<Type, double>::value;
+
+/** Sequential writer for the cache file */
+struct writer_t
+{
+    std::string data;
+
+    template<class Int>
+    void write_int(Int value)
+    {
+        data.append((const char*)&value, sizeof(value));
+    }
+
+    void write_string(const std::string& str)
+    {
+        write_int<uint32_t>(str.size());
+        data.append(str);
+    }
+};
+
+/** Sequential reader for the mapped cache file, with bounds checks */
+struct reader_t
+{
+    const char *pos;
+    const char *end;
+
+    template<class Int>
+    bool read_int(Int& value)
+    {
+        if (end - pos < (ptrdiff_t)sizeof(value))
+        {
+            return false;
+        }
+
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    bool read_string(std::string& str)
+    {
+        uint32_t size;
+        if (!read_int(size) || (end - pos < (ptrdiff_t)size))
+        {
+            return false;
+        }
+
+        str.assign(pos, size);
+        pos += size;
+        return true;
+    }
+};
+
+int get_option_tag(const std::shared_ptr<wf::config::option_base_t>& option)
+{
+    for (uint8_t tag = 0; tag < TAG_COUNT; tag++)
+    {
+        bool match = false;
+        with_option_type(tag, [&] (auto t)
+        {
+            using Type = typename decltype(t)::type;
+            match = (bool)std::dynamic_pointer_cast<
+                wf::config::option_t<Type>>(option);
+        });
+
+        if (match)
+        {
+            return tag;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Option layout: tag, name, default value, value, then for int and double
+ * options a flags byte (1 = minimum, 2 = maximum) followed by the bounds.
+ */
+bool write_option(writer_t& out,
+    const std::shared_ptr<wf::config::option_base_t>& option)
+{
+    int tag = get_option_tag(option);
+    if (tag < 0)
+    {
+        return false;
+    }
+
+    out.write_int<uint8_t>(tag);
+    out.write_string(option->get_name());
+    out.write_string(option->get_default_value_str());
+    out.write_string(option->get_value_str());
+    with_option_type(tag, [&] (auto t)
+    {
+        using Type = typename decltype(t)::type;
+        if constexpr (has_bounds<Type>)
+        {
+            auto typed =
+                std::dynamic_pointer_cast<wf::config::option_t<Type>>(option);
+            auto min = typed->get_minimum();
+            auto max = typed->get_maximum();
+
+            out.write_int<uint8_t>((min ? 1 : 0) | (max ? 2 : 0));
+            if (min)
+            {
+                out.write_string(wf::option_type::to_string<Type>(*min));
+            }
+
+            if (max)
+            {
+                out.write_string(wf::option_type::to_string<Type>(*max));
+            }
+        }
+    });
+
+    return true;
+}
+
+std::shared_ptr<wf::config::option_base_t> read_option(reader_t& in)
+{
+    uint8_t tag;
+    std::string name, default_value, value;
+    if (!in.read_int(tag) || !in.read_string(name) ||
+        !in.read_string(default_value) || !in.read_string(value))
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<wf::config::option_base_t> result;
+    bool known = with_option_type(tag, [&] (auto t)
+    {
+        using Type = typename decltype(t)::type;
+        auto parsed = wf::option_type::from_string<Type>(default_value);
+        if (!parsed)
+        {
+            return;
+        }
+
+        auto option =
+            std::make_shared<wf::config::option_t<Type>>(name, *parsed);
+        if constexpr (has_bounds<Type>)
+        {
+            uint8_t flags;
+            std::string bound;
+            if (!in.read_int(flags))
+            {
+                return;
+            }
+
+            if (flags & 1)
+            {
+                auto min = in.read_string(bound) ?
+                    wf::option_type::from_string<Type>(bound) : std::nullopt;
+                if (!min)
+                {
+                    return;
+                }
+
+                option->set_minimum(*min);
+            }
+
+            if (flags & 2)
+            {
+                auto max = in.read_string(bound) ?
+                    wf::option_type::from_string<Type>(bound) : std::nullopt;
+                if (!max)
+                {
+                    return;
+                }
+
+                option->set_maximum(*max);
+            }
+        }
+
+        if (option->set_value_str(value))
+        {
+            result = option;
+        }
+    });
+
+    return known ? result : nullptr;
+}
+
+/** FNV-1a */
+void hash_bytes(uint64_t& hash, const void *data, size_t size)
+{
+    auto bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+void hash_file(uint64_t& hash, const std::string& path)
+{
+    hash_bytes(hash, path.data(), path.size() + 1);
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        return;
+    }
+
+    hash_bytes(hash, &st.st_size, sizeof(st.st_size));
+    hash_bytes(hash, &st.st_mtim, sizeof(st.st_mtim));
+
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    auto str = contents.str();
+    hash_bytes(hash, str.data(), str.size());
+}
+
+bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+namespace wf
+{
+namespace metadata_cache
+{
+std::string get_default_path()
+{
+    std::string cache_dir = nonull(getenv("XDG_CACHE_HOME"));
+    if (!cache_dir.compare("nil"))
+    {
+        cache_dir = std::string(nonull(getenv("HOME"))) + "/.cache";
+    }
+
+    return cache_dir + "/wayfire/metadata.cache";
+}
+
+uint64_t compute_key(const std::vector<std::string>& xmldirs,
+    const std::string& sysconf)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash_bytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    for (auto& dir : xmldirs)
+    {
+        std::vector<std::string> files;
+        if (DIR *d = opendir(dir.c_str()))
+        {
+            while (auto entry = readdir(d))
+            {
+                std::string name = entry->d_name;
+                if (ends_with(name, ".xml"))
+                {
+                    files.push_back(dir + "/" + name);
+                }
+            }
+
+            closedir(d);
+        }
+
+        std::sort(files.begin(), files.end());
+        for (auto& file : files)
+        {
+            hash_file(hash, file);
+        }
+    }
+
+    hash_file(hash, sysconf);
+    return hash;
+}
+
+bool load(const std::string& path, uint64_t key,
+    config::config_manager_t& config)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    reader_t in{(const char*)map, (const char*)map + st.st_size};
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t version, num_sections;
+    uint64_t stored_key;
+    std::vector<std::shared_ptr<config::section_t>> sections;
+
+    bool valid = (in.end - in.pos >= (ptrdiff_t)sizeof(magic));
+    if (valid)
+    {
+        std::memcpy(magic, in.pos, sizeof(magic));
+        in.pos += sizeof(magic);
+        valid = !std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) &&
+            in.read_int(version) && (version == CACHE_VERSION) &&
+            in.read_int(stored_key) && (stored_key == key) &&
+            in.read_int(num_sections);
+    }
+
+    for (uint32_t i = 0; valid && i < num_sections; i++)
+    {
+        std::string name;
+        uint32_t num_options;
+        valid = in.read_string(name) && in.read_int(num_options);
+
+        auto section = std::make_shared<config::section_t>(name);
+        for (uint32_t j = 0; valid && j < num_options; j++)
+        {
+            auto option = read_option(in);
+            valid = (option != nullptr);
+            if (valid)
+            {
+                section->register_new_option(option);
+            }
+        }
+
+        sections.push_back(section);
+    }
+
+    munmap(map, st.st_size);
+    if (!valid)
+    {
+        LOGD("Metadata cache ", path, " is stale or invalid");
+        return false;
+    }
+
+    for (auto& section : sections)
+    {
+        config.merge_section(section);
+    }
+
+    return true;
+}
+
+void save(const std::string& path, uint64_t key,
+    const config::config_manager_t& config)
+{
+    writer_t out;
+    out.data.append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    out.write_int(CACHE_VERSION);
+    out.write_int(key);
+
+    auto sections = config.get_all_sections();
+    out.write_int<uint32_t>(sections.size());
+    for (auto& section : sections)
+    {
+        auto options = section->get_registered_options();
+        out.write_string(section->get_name());
+        out.write_int<uint32_t>(options.size());
+        for (auto& option : options)
+        {
+            if (!write_option(out, option))
+            {
+                LOGD("Not caching metadata, unknown type of option ",
+                    section->get_name(), "/", option->get_name());
+                return;
+            }
+        }
+    }
+
+    /* Create the cache directory and its parent, if they don't exist yet */
+    auto dir = path.substr(0, path.find_last_of('/'));
+    mkdir(dir.substr(0, dir.find_last_of('/')).c_str(), 0700);
+    mkdir(dir.c_str(), 0700);
+
+    /* Write to a temporary file first, so that concurrently starting
+     * instances never see a partially written cache */
+    auto tmp_path = path + "." + std::to_string(getpid());
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(out.data.data(), out.data.size());
+    file.close();
+    if (!file || (rename(tmp_path.c_str(), path.c_str()) != 0))
+    {
+        LOGW("Failed to write metadata cache ", path);
+        unlink(tmp_path.c_str());
+    }
+}
+}
+}
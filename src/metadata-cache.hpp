@@ -0,0 +1,45 @@
+#pragma once
+
+#include <wayfire/config/config-manager.hpp>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+/**
+ * A binary cache of the option metadata (names, types, defaults and ranges)
+ * which is otherwise parsed from the plugin XML files on every start.
+ *
+ * The cache is keyed by a hash of the paths, modification times and contents
+ * of the XML files and the system defaults file, so any change to them makes
+ * it stale, in which case the caller falls back to parsing the XML files.
+ */
+namespace metadata_cache
+{
+/** @return The default location of the cache file. */
+std::string get_default_path();
+
+/**
+ * Compute the key of the metadata described by the given XML directories
+ * and system defaults file.
+ */
+uint64_t compute_key(const std::vector<std::string>& xmldirs,
+    const std::string& sysconf);
+
+/**
+ * Populate config with the sections and options stored in the cache.
+ *
+ * @return false if the cache doesn't exist, is corrupted or has a different
+ *   key. In that case, config is left unchanged.
+ */
+bool load(const std::string& path, uint64_t key,
+    config::config_manager_t& config);
+
+/**
+ * Store the sections and options of config in the cache. Failures are only
+ * logged, since the cache is just an optimization.
+ */
+void save(const std::string& path, uint64_t key,
+    const config::config_manager_t& config);
+}
+}
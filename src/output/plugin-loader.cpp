@@ -3,6 +3,7 @@
 #include <set>
 #include <memory>
 #include <filesystem>
+#include <fstream>
 #include <dlfcn.h>
 
 #include "plugin-loader.hpp"
@@ -10,6 +11,8 @@
 #include "wayfire/output.hpp"
 #include "../core/wm.hpp"
 #include "wayfire/core.hpp"
+#include "../core/startup-timeline.hpp"
+#include <wayfire/thread-pool.hpp>
 #include <wayfire/util/log.hpp>
 
 
@@ -53,8 +56,11 @@ plugin_manager::~plugin_manager()
     loaded_plugins.clear();
 }
 
-void plugin_manager::init_plugin(wayfire_plugin& p)
+void plugin_manager::init_plugin(wayfire_plugin& p, const std::string& name)
 {
+    wf::startup_timeline::phase_t phase{"init " + name + " on " +
+        output->to_string()};
+
     p->grab_interface = std::make_unique<wf::plugin_grab_interface_t>(output);
     p->output = output;
     p->init();
@@ -81,8 +87,55 @@ void plugin_manager::destroy_plugin(wayfire_plugin& p)
     }
 }
 
+/** Find the files of the plugins in the given list */
+static std::vector<std::string> get_plugin_paths(const std::string& plugin_list)
+{
+    std::stringstream stream(plugin_list);
+    std::vector<std::string> next_plugins;
+
+    std::vector<std::string> plugin_prefixes;
+    if (char *plugin_path = getenv("WAYFIRE_PLUGIN_PATH"))
+    {
+        std::stringstream ss(plugin_path);
+        std::string entry;
+        while (std::getline(ss, entry, ':'))
+        {
+            plugin_prefixes.push_back(entry);
+        }
+    }
+
+    plugin_prefixes.push_back(PLUGIN_PATH);
+
+    std::string plugin_name;
+    while (stream >> plugin_name)
+    {
+        if (plugin_name.size())
+        {
+            if (plugin_name.at(0) == '/')
+            {
+                next_plugins.push_back(plugin_name);
+                continue;
+            }
+
+            for (std::filesystem::path plugin_prefix : plugin_prefixes)
+            {
+                auto plugin_path = plugin_prefix / ("lib" + plugin_name + ".so");
+                if (std::filesystem::exists(plugin_path))
+                {
+                    next_plugins.push_back(plugin_path);
+                    break;
+                }
+            }
+        }
+    }
+
+    return next_plugins;
+}
+
 std::pair<void*, void*> wf::get_new_instance_handle(const std::string& path)
 {
+    wf::startup_timeline::phase_t phase{"dlopen " + path};
+
     // RTLD_GLOBAL is required for RTTI/dynamic_cast across plugins
     void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
     if (handle == NULL)
@@ -125,6 +178,27 @@ std::pair<void*, void*> wf::get_new_instance_handle(const std::string& path)
     return {handle, new_instance_func_ptr};
 }
 
+void wf::preload_plugins()
+{
+    wf::option_wrapper_t<std::string> plugins_opt{"core/plugins"};
+    auto& pool = wf::get_core().get_thread_pool();
+    for (auto& path : get_plugin_paths(plugins_opt))
+    {
+        pool.submit([=] ()
+        {
+            /* Read the whole file, so that it is in the page cache when the
+             * main thread opens it */
+            wf::startup_timeline::phase_t phase{"prefetch " + path};
+            std::ifstream file(path, std::ios::binary);
+            std::vector<char> buffer(64 * 1024);
+            while (file)
+            {
+                file.read(buffer.data(), buffer.size());
+            }
+        });
+    }
+}
+
 wayfire_plugin plugin_manager::load_plugin_from_file(std::string path)
 {
     auto [handle, new_instance_func_ptr] = wf::get_new_instance_handle(path);
@@ -153,45 +227,7 @@ void plugin_manager::reload_dynamic_plugins()
              "ensure your configuration file is set up properly.");
     }
 
-    std::stringstream stream(plugin_list);
-    std::vector<std::string> next_plugins;
-
-    auto plugin_prefix = std::string(PLUGIN_PATH "/");
-    std::vector<std::string> plugin_prefixes;
-    if (char *plugin_path = getenv("WAYFIRE_PLUGIN_PATH"))
-    {
-        std::stringstream ss(plugin_path);
-        std::string entry;
-        while (std::getline(ss, entry, ':'))
-        {
-            plugin_prefixes.push_back(entry);
-        }
-    }
-
-    plugin_prefixes.push_back(PLUGIN_PATH);
-
-    std::string plugin_name;
-    while (stream >> plugin_name)
-    {
-        if (plugin_name.size())
-        {
-            if (plugin_name.at(0) == '/')
-            {
-                next_plugins.push_back(plugin_name);
-                continue;
-            }
-
-            for (std::filesystem::path plugin_prefix : plugin_prefixes)
-            {
-                auto plugin_path = plugin_prefix / ("lib" + plugin_name + ".so");
-                if (std::filesystem::exists(plugin_path))
-                {
-                    next_plugins.push_back(plugin_path);
-                    break;
-                }
-            }
-        }
-    }
+    auto next_plugins = get_plugin_paths(plugin_list);
 
     /* erase plugins that have been removed from the config */
     auto it = loaded_plugins.begin();
@@ -228,7 +264,7 @@ void plugin_manager::reload_dynamic_plugins()
         auto ptr = load_plugin_from_file(plugin);
         if (ptr)
         {
-            init_plugin(ptr);
+            init_plugin(ptr, plugin);
             loaded_plugins[plugin] = std::move(ptr);
         }
     }
@@ -246,7 +282,7 @@ void plugin_manager::load_static_plugins()
     loaded_plugins["_focus"] = create_plugin<wayfire_focus>();
     loaded_plugins["_close"] = create_plugin<wayfire_close>();
 
-    init_plugin(loaded_plugins["_exit"]);
-    init_plugin(loaded_plugins["_focus"]);
-    init_plugin(loaded_plugins["_close"]);
+    init_plugin(loaded_plugins["_exit"], "_exit");
+    init_plugin(loaded_plugins["_focus"], "_focus");
+    init_plugin(loaded_plugins["_close"], "_close");
 }
@@ -34,7 +34,7 @@ struct plugin_manager
     wayfire_plugin load_plugin_from_file(std::string path);
     void load_static_plugins();
 
-    void init_plugin(wayfire_plugin& plugin);
+    void init_plugin(wayfire_plugin& plugin, const std::string& name);
     void destroy_plugin(wayfire_plugin& plugin);
 };
 
@@ -62,6 +62,14 @@ B union_cast(A object)
  * @return (dlopen() handle, newInstance pointer)
  */
 std::pair<void*, void*> get_new_instance_handle(const std::string& path);
+
+/**
+ * Start reading the files of the plugins listed in core/plugins on worker
+ * threads, so that the disk I/O overlaps with the initialization of core.
+ * The plugins are still opened with dlopen() on the main thread, once core
+ * has been initialized.
+ */
+void preload_plugins();
 }
 
 #endif /* end of include guard: PLUGIN_LOADER_HPP */
@@ -7,8 +7,12 @@
 #include "wayfire/workspace-manager.hpp"
 #include "../core/seat/seat.hpp"
 #include "../core/opengl-priv.hpp"
+#include "../core/startup-timeline.hpp"
 #include "../main.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
 #include <wayfire/nonstd/reverse.hpp>
 #include <wayfire/nonstd/safe-list.hpp>
 #include <wayfire/util/log.hpp>
@@ -68,6 +72,23 @@ struct output_damage_t
         wlr_output_damage_add_box(damage_manager, &scaled_box);
     }
 
+    /**
+     * Record that the given region was repainted in the current frame, without
+     * scheduling a new frame. This way, the repainted region is included in the
+     * buffer age damage of the next frames.
+     */
+    void add_repainted(const wf::region_t& region)
+    {
+        if (!damage_manager)
+        {
+            return;
+        }
+
+        auto scaled_region = (region * wo->handle->scale) & get_wlr_damage_box();
+        pixman_region32_union(&damage_manager->current,
+            &damage_manager->current, scaled_region.to_pixman());
+    }
+
     wf::region_t acc_damage;
 
     /**
@@ -751,6 +772,10 @@ class wf::render_manager::impl
         output_damage->damage_whole_idle();
     }
 
+    /* The region repainted by the custom renderer in the current frame, if it
+     * reported one */
+    std::optional<wf::region_t> renderer_damage;
+
     int constant_redraw_counter = 0;
     void set_redraw_always(bool always)
     {
@@ -785,6 +810,22 @@ class wf::render_manager::impl
         }
     }
 
+    int frame_hold_counter = 0;
+    void add_frame_hold(bool add)
+    {
+        frame_hold_counter += add ? 1 : -1;
+        if (frame_hold_counter < 0)
+        {
+            LOGE("frame_hold_counter got below 0!");
+            frame_hold_counter = 0;
+        }
+
+        if (frame_hold_counter == 0)
+        {
+            output_damage->schedule_repaint();
+        }
+    }
+
     /* Actual rendering functions */
 
     /**
@@ -930,9 +971,19 @@ class wf::render_manager::impl
     {
         if (renderer)
         {
+            renderer_damage.reset();
             renderer(postprocessing->get_target_framebuffer());
-            /* TODO: let custom renderers specify what they want to repaint... */
-            swap_damage |= output_damage->get_wlr_damage_box();
+            if (renderer_damage)
+            {
+                /* Regions repainted by the renderer which weren't damaged
+                 * have to be repainted in the other buffers too */
+                output_damage->add_repainted(*renderer_damage);
+                swap_damage |= *renderer_damage * output->handle->scale;
+                swap_damage &= output_damage->get_wlr_damage_box();
+            } else
+            {
+                swap_damage |= output_damage->get_wlr_damage_box();
+            }
         } else
         {
             swap_damage =
@@ -967,6 +1018,17 @@ class wf::render_manager::impl
      */
     void paint()
     {
+        auto paint_start = std::chrono::steady_clock::now();
+
+        if (frame_hold_counter)
+        {
+            /* Keep showing the last frame, damage accumulates until the hold
+             * is released */
+            delay_manager->skip_frame();
+            last_paint_valid = false;
+            return;
+        }
+
         /* Part 1: frame setup: query damage, etc. */
         effects->run_effects(OUTPUT_EFFECT_PRE);
         effects->run_effects(OUTPUT_EFFECT_DAMAGE);
@@ -975,6 +1037,7 @@ class wf::render_manager::impl
         {
             // Yet another optimization: if we can directly scanout, we should
             // stop the rest of the repaint cycle.
+            update_frame_timing(paint_start);
             return;
         } else
         {
@@ -986,6 +1049,7 @@ class wf::render_manager::impl
         {
             wlr_output_rollback(output->handle);
             delay_manager->skip_frame();
+            last_paint_valid = false;
             return;
         }
 
@@ -996,6 +1060,7 @@ class wf::render_manager::impl
              * repaint */
             wlr_output_rollback(output->handle);
             delay_manager->skip_frame();
+            last_paint_valid = false;
             return;
         }
 
@@ -1036,9 +1101,60 @@ class wf::render_manager::impl
         OpenGL::unbind_output(output);
         output_damage->swap_buffers(swap_damage);
         swap_damage.clear();
+        update_frame_timing(paint_start);
+        wf::startup_timeline::finish();
         post_paint();
     }
 
+    /* Timing of the last painted frames, see get_frame_timing() */
+    frame_timing_t frame_timing;
+    std::chrono::steady_clock::time_point last_paint_start;
+    /* Whether the last frame was painted, i.e whether frame_interval can be
+     * measured on the next frame */
+    bool last_paint_valid = false;
+
+    /**
+     * Update the frame timing after a frame has been painted.
+     *
+     * @param paint_start The time when painting the frame started.
+     */
+    void update_frame_timing(std::chrono::steady_clock::time_point paint_start)
+    {
+        using namespace std::chrono;
+        auto now = steady_clock::now();
+
+        frame_timing.refresh_interval = 0;
+        if (output->handle->refresh > 0)
+        {
+            /* refresh is in mHz */
+            frame_timing.refresh_interval = 1'000'000'000ll /
+                output->handle->refresh;
+        }
+
+        frame_timing.frame_interval = -1;
+        if (last_paint_valid)
+        {
+            frame_timing.frame_interval =
+                duration_cast<microseconds>(paint_start - last_paint_start).count();
+        }
+
+        /* If the last frame was painted long before, nothing was scheduled in
+         * between (for ex. only a cursor blinked), so the output was idle
+         * rather than late. A frame which missed a single vblank is still
+         * counted as late. */
+        if ((frame_timing.refresh_interval > 0) &&
+            (frame_timing.frame_interval > frame_timing.refresh_interval * 5 / 2))
+        {
+            frame_timing.frame_interval = -1;
+        }
+
+        frame_timing.render_time =
+            duration_cast<microseconds>(now - paint_start).count();
+
+        last_paint_start = paint_start;
+        last_paint_valid = true;
+    }
+
     /**
      * Execute post-paint actions.
      */
@@ -1244,9 +1360,9 @@ class wf::render_manager::impl
      * they need repaint.
      */
     void check_schedule_surfaces(workspace_stream_repaint_t& repaint,
-        workspace_stream_t& stream)
+        wf::point_t ws)
     {
-        auto views = output->workspace->get_views_on_workspace(stream.ws,
+        auto views = output->workspace->get_views_on_workspace(ws,
             wf::VISIBLE_LAYERS);
 
         schedule_drag_icon(repaint);
@@ -1300,23 +1416,26 @@ class wf::render_manager::impl
         workspace_stream_repaint_t repaint;
         repaint.ws_damage = output_damage->get_ws_damage(stream.ws);
 
-        /* we don't have to update anything */
-        if (repaint.ws_damage.empty())
+        /* Framebuffers support only a uniform scale, so the stream is
+         * rendered with the larger of the two */
+        float scale = wf::clamp(std::max(scale_x, scale_y), 0.01f, 1.0f);
+        if (scale != stream.scale_x)
         {
-            return repaint;
+            /* The buffer is reallocated, so it has to be repainted fully */
+            stream.scale_x = stream.scale_y = scale;
+            repaint.ws_damage |= output_damage->get_ws_box(stream.ws);
         }
 
-        if ((scale_x != stream.scale_x) || (scale_y != stream.scale_y))
+        /* we don't have to update anything */
+        if (repaint.ws_damage.empty())
         {
-            /* FIXME: enable scaled rendering */
-            // stream->scale_x = scale_x;
-            // stream->scale_y = scale_y;
-
-            // ws_damage |= get_damage_box();
+            return repaint;
         }
 
         OpenGL::render_begin();
-        stream.buffer.allocate(output->handle->width, output->handle->height);
+        stream.buffer.allocate(
+            std::max(1, (int)std::ceil(output->handle->width * scale)),
+            std::max(1, (int)std::ceil(output->handle->height * scale)));
         OpenGL::render_end();
 
         repaint.fb = postprocessing->get_target_framebuffer();
@@ -1325,6 +1444,9 @@ class wf::render_manager::impl
             /* Use the workspace buffers */
             repaint.fb.fb  = stream.buffer.fb;
             repaint.fb.tex = stream.buffer.tex;
+            repaint.fb.viewport_width  = stream.buffer.viewport_width;
+            repaint.fb.viewport_height = stream.buffer.viewport_height;
+            repaint.fb.scale *= scale;
         }
 
         auto g   = output->get_relative_geometry();
@@ -1403,21 +1525,64 @@ class wf::render_manager::impl
             output->render->emit_signal("workspace-stream-pre", &data);
         }
 
-        check_schedule_surfaces(repaint, stream);
-
         if (stream.background.a < 0)
         {
-            clear_empty_areas(repaint, background_color_opt);
+            repaint_workspace(repaint, stream.ws, background_color_opt);
         } else
         {
-            clear_empty_areas(repaint, stream.background);
+            repaint_workspace(repaint, stream.ws, stream.background);
         }
 
-        render_views(repaint);
+        stream.has_mipmaps = false;
+        {
+            stream_signal_t data(stream.ws, repaint.ws_damage, repaint.fb);
+            output->render->emit_signal("workspace-stream-post", &data);
+        }
+    }
 
+    /**
+     * Render the views of the workspace in the damaged region of the repaint.
+     */
+    void repaint_workspace(workspace_stream_repaint_t& repaint, wf::point_t ws,
+        wf::color_t background)
+    {
+        check_schedule_surfaces(repaint, ws);
+        clear_empty_areas(repaint, background);
+        render_views(repaint);
         unschedule_drag_icon();
+    }
+
+    void render_workspace(wf::point_t ws, const wf::framebuffer_t& fb,
+        wf::point_t position, const wf::region_t& damage)
+    {
+        workspace_stream_repaint_t repaint;
+        auto ws_box = output_damage->get_ws_box(ws);
+        repaint.ws_dx = ws_box.x;
+        repaint.ws_dy = ws_box.y;
+
+        /* Translate the framebuffer so that the workspace box lands on the
+         * requested position */
+        wf::point_t delta = {ws_box.x - position.x, ws_box.y - position.y};
+        repaint.fb = fb;
+        repaint.fb.geometry.x += delta.x;
+        repaint.fb.geometry.y += delta.y;
+        repaint.ws_damage = (damage + delta) & ws_box;
+        if (repaint.ws_damage.empty())
         {
-            stream_signal_t data(stream.ws, repaint.ws_damage, repaint.fb);
+            return;
+        }
+
+        {
+            stream_signal_t data(ws, repaint.ws_damage, repaint.fb);
+            output->render->emit_signal("workspace-stream-pre", &data);
+        }
+
+        /* Plugins may have expanded the damage, but the neighbouring parts of
+         * the framebuffer don't belong to this workspace */
+        repaint.ws_damage &= ws_box;
+        repaint_workspace(repaint, ws, background_color_opt);
+        {
+            stream_signal_t data(ws, repaint.ws_damage, repaint.fb);
             output->render->emit_signal("workspace-stream-post", &data);
         }
     }
@@ -1437,6 +1602,11 @@ void render_manager::set_renderer(render_hook_t rh)
     pimpl->set_renderer(rh);
 }
 
+void render_manager::set_renderer_damage(const wf::region_t& region)
+{
+    pimpl->renderer_damage = region;
+}
+
 void render_manager::set_redraw_always(bool always)
 {
     pimpl->set_redraw_always(always);
@@ -1457,6 +1627,11 @@ void render_manager::add_inhibit(bool add)
     pimpl->add_inhibit(add);
 }
 
+void render_manager::add_frame_hold(bool add)
+{
+    pimpl->add_frame_hold(add);
+}
+
 void render_manager::add_effect(effect_hook_t *hook, output_effect_type_t type)
 {
     pimpl->effects->add_effect(hook, type);
@@ -1512,6 +1687,11 @@ wf::framebuffer_t render_manager::get_target_framebuffer() const
     return pimpl->postprocessing->get_target_framebuffer();
 }
 
+frame_timing_t render_manager::get_frame_timing() const
+{
+    return pimpl->frame_timing;
+}
+
 void render_manager::workspace_stream_start(workspace_stream_t& stream)
 {
     pimpl->workspace_stream_start(stream);
@@ -1520,13 +1700,19 @@ void render_manager::workspace_stream_start(workspace_stream_t& stream)
 void render_manager::workspace_stream_update(workspace_stream_t& stream,
     float scale_x, float scale_y)
 {
-    pimpl->workspace_stream_update(stream);
+    pimpl->workspace_stream_update(stream, scale_x, scale_y);
 }
 
 void render_manager::workspace_stream_stop(workspace_stream_t& stream)
 {
     pimpl->workspace_stream_stop(stream);
 }
+
+void render_manager::render_workspace(wf::point_t ws,
+    const wf::framebuffer_t& fb, wf::point_t position, const wf::region_t& damage)
+{
+    pimpl->render_workspace(ws, fb, position, damage);
+}
 } // namespace wf
 
 /* End render_manager */
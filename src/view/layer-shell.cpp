@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <optional>
 
 #include "xdg-shell.hpp"
 #include "wayfire/core.hpp"
@@ -44,6 +45,12 @@ class wayfire_layer_shell_view : public wf::wlr_view_t
 
     void configure(wf::geometry_t geometry);
 
+    /* The last configured box and the desired size it was computed for, so
+     * that unchanged configures aren't sent again on every arrangement */
+    std::optional<wf::geometry_t> last_configured;
+    uint32_t last_desired_width  = 0;
+    uint32_t last_desired_height = 0;
+
     /** Calculate the target layer for this layer surface */
     wf::layer_t get_layer();
 };
@@ -313,6 +320,57 @@ struct wf_layer_shell_manager
         return focus_mask;
     }
 
+    void update_focused_layer()
+    {
+        auto focus_mask = determine_focused_layer();
+        focused_layer_request_uid = wf::get_core().focus_layer(focus_mask,
+            focused_layer_request_uid);
+    }
+
+    /**
+     * Update the arrangement after the state of a view changed, but not its
+     * layer. Only the view's own reserved area is recomputed, and the other
+     * views are repositioned only if the workarea changed.
+     */
+    void arrange_view(wayfire_layer_shell_view *view,
+        const wlr_layer_surface_v1_state& old_state)
+    {
+        auto output = view->get_output();
+        bool was_exclusive = old_state.exclusive_zone > 0;
+        bool is_exclusive  = view->lsurface->current.exclusive_zone > 0;
+
+        if (!was_exclusive && !is_exclusive)
+        {
+            pin_view(view, output->workspace->get_workarea());
+            update_focused_layer();
+
+            return;
+        }
+
+        auto old_workarea = output->workspace->get_workarea();
+        if (is_exclusive)
+        {
+            set_exclusive_zone(view);
+        } else
+        {
+            view->remove_anchored(false);
+        }
+
+        output->workspace->reflow_reserved_areas();
+
+        auto workarea = output->workspace->get_workarea();
+        for (auto v : filter_views(output))
+        {
+            if ((v->lsurface->current.exclusive_zone < 1) &&
+                ((v == view) || (workarea != old_workarea)))
+            {
+                pin_view(v, workarea);
+            }
+        }
+
+        update_focused_layer();
+    }
+
     uint32_t focused_layer_request_uid = -1;
     void arrange_layers(wf::output_t *output)
     {
@@ -323,9 +381,7 @@ struct wf_layer_shell_manager
         arrange_layer(output, ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM);
         arrange_layer(output, ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND);
 
-        auto focus_mask = determine_focused_layer();
-        focused_layer_request_uid = wf::get_core().focus_layer(focus_mask,
-            focused_layer_request_uid);
+        update_focused_layer();
         output->workspace->reflow_reserved_areas();
     }
 };
@@ -452,6 +508,24 @@ void wayfire_layer_shell_view::unmap()
     wf_layer_shell_manager::get_instance().handle_unmap(this);
 }
 
+/**
+ * Check whether the state relevant for arranging the layers changed.
+ * The actual size is left out, since it changes whenever the client acks a
+ * configure, which would otherwise trigger another arrangement.
+ */
+static bool arrangement_changed(const wlr_layer_surface_v1_state& a,
+    const wlr_layer_surface_v1_state& b)
+{
+    return (a.anchor != b.anchor) || (a.exclusive_zone != b.exclusive_zone) ||
+           (a.margin.top != b.margin.top) ||
+           (a.margin.bottom != b.margin.bottom) ||
+           (a.margin.left != b.margin.left) ||
+           (a.margin.right != b.margin.right) ||
+           (a.keyboard_interactive != b.keyboard_interactive) ||
+           (a.desired_width != b.desired_width) ||
+           (a.desired_height != b.desired_height) || (a.layer != b.layer);
+}
+
 void wayfire_layer_shell_view::commit()
 {
     wf::wlr_view_t::commit();
@@ -461,7 +535,7 @@ void wayfire_layer_shell_view::commit()
      * the view state changed, then this will happen when arranging layers */
     view_impl->keyboard_focus_enabled = state->keyboard_interactive;
 
-    if (std::memcmp(state, &prev_state, sizeof(*state)))
+    if (arrangement_changed(*state, prev_state))
     {
         /* Update layer manualy */
         if (prev_state.layer != state->layer)
@@ -471,12 +545,12 @@ void wayfire_layer_shell_view::commit()
             wf_layer_shell_manager::get_instance().handle_move_layer(this);
         } else
         {
-            /* Reflow reserved areas and positions */
-            wf_layer_shell_manager::get_instance().arrange_layers(get_output());
+            /* Reflow this view's reserved area and the positions */
+            wf_layer_shell_manager::get_instance().arrange_view(this, prev_state);
         }
-
-        prev_state = *state;
     }
+
+    prev_state = *state;
 }
 
 void wayfire_layer_shell_view::close()
@@ -521,6 +595,17 @@ void wayfire_layer_shell_view::configure(wf::geometry_t box)
         close();
     }
 
+    if ((last_configured == box) &&
+        (last_desired_width == state->desired_width) &&
+        (last_desired_height == state->desired_height))
+    {
+        return;
+    }
+
+    last_configured     = box;
+    last_desired_width  = state->desired_width;
+    last_desired_height = state->desired_height;
+
     wf::wlr_view_t::move(box.x, box.y);
     wlr_layer_surface_v1_configure(lsurface, box.width, box.height);
 }
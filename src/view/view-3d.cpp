@@ -43,6 +43,12 @@ void wf::view_transformer_t::render_with_damage(wf::texture_t src_tex,
     }
 }
 
+bool wf::view_transformer_t::get_fused_transform(wf::geometry_t view,
+    glm::mat4& matrix, glm::vec4& color)
+{
+    return false;
+}
+
 struct transformable_quad
 {
     gl_geometry geometry;
@@ -75,6 +81,22 @@ static wf::pointf_t get_absolute_coords_from_relative(wf::geometry_t view,
     };
 }
 
+/**
+ * Wrap a matrix which operates in a coordinate system centered at the given
+ * point, with Y pointing upwards, so that it operates on output-local
+ * coordinates instead.
+ */
+static glm::mat4 wrap_centered_matrix(wf::pointf_t center, glm::mat4 matrix)
+{
+    auto to_center = glm::translate(glm::mat4(1.0),
+        {-center.x, -center.y, 0});
+    auto from_center = glm::translate(glm::mat4(1.0),
+        {center.x, center.y, 0});
+    auto flip_y = glm::scale(glm::mat4(1.0), {1, -1, 1});
+
+    return from_center * flip_y * matrix * flip_y * to_center;
+}
+
 static transformable_quad center_geometry(wf::geometry_t output_geometry,
     wf::geometry_t geometry,
     wf::point_t target_center)
@@ -173,6 +195,25 @@ void wf::view_2D::render_box(wf::texture_t src_tex, wlr_box src_box,
     OpenGL::render_end();
 }
 
+bool wf::view_2D::get_fused_transform(wf::geometry_t geometry,
+    glm::mat4& matrix, glm::vec4& color)
+{
+    /* Same rounding as render_box(), so that the view doesn't shift when
+     * switching between the two paths */
+    auto center_int = get_center(view->get_wm_geometry());
+    wf::pointf_t center = {1.0 * center_int.x, 1.0 * center_int.y};
+
+    auto scale     = glm::scale(glm::mat4(1.0), {scale_x, scale_y, 1});
+    auto rotate    = glm::rotate(glm::mat4(1.0), angle, {0, 0, 1});
+    auto translate = glm::translate(glm::mat4(1.0),
+        {translation_x, -translation_y, 0});
+
+    matrix = wrap_centered_matrix(center, translate * rotate * scale);
+    color  = {1.0f, 1.0f, 1.0f, alpha};
+
+    return true;
+}
+
 const float wf::view_3D::fov = PI / 4;
 glm::mat4 wf::view_3D::default_view_matrix()
 {
@@ -234,6 +275,18 @@ wf::pointf_t wf::view_3D::untransform_point(wf::geometry_t geometry,
         wf::compositor_core_t::invalid_coordinate};
 }
 
+bool wf::view_3D::get_fused_transform(wf::geometry_t geometry,
+    glm::mat4& matrix, glm::vec4& color)
+{
+    auto center_int = get_center(geometry);
+    wf::pointf_t center = {1.0 * center_int.x, 1.0 * center_int.y};
+
+    matrix = wrap_centered_matrix(center, calculate_total_transform());
+    color  = this->color;
+
+    return true;
+}
+
 void wf::view_3D::render_box(wf::texture_t src_tex, wlr_box src_box,
     wlr_box scissor_box, const wf::framebuffer_t& fb)
 {
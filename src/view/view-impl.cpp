@@ -559,10 +559,19 @@ void wf::init_desktop_apis()
     init_xdg_shell();
     init_layer_shell();
 
-    wf::option_wrapper_t<bool> xwayland_enabled("core/xwayland");
-    if (xwayland_enabled == 1)
+    /* true and false are the values of the former boolean option */
+    wf::option_wrapper_t<std::string> xwayland_mode("core/xwayland");
+    std::string mode = xwayland_mode;
+    if (mode == "eager")
     {
-        init_xwayland();
+        init_xwayland(false);
+    } else if ((mode == "lazy") || (mode == "true"))
+    {
+        init_xwayland(true);
+    } else if ((mode != "off") && (mode != "false"))
+    {
+        LOGE("Invalid value for core/xwayland: ", mode, ", using lazy");
+        init_xwayland(true);
     }
 }
 
@@ -67,6 +67,8 @@ class view_interface_t::view_priv_impl
     struct offscreen_buffer_t : public wf::framebuffer_t
     {
         wf::region_t cached_damage;
+        /* Whether the mipmaps are up-to-date with the snapshot */
+        bool has_mipmaps = false;
         bool valid()
         {
             return this->fb != (uint32_t)-1;
@@ -237,7 +239,11 @@ wf::surface_interface_t *wf_surface_from_void(void *handle);
 wf::view_interface_t *wf_view_from_void(void *handle);
 
 void init_xdg_shell();
-void init_xwayland();
+/**
+ * Start Xwayland. In lazy mode, only the X11 sockets are created, and the
+ * server is started when the first X11 client connects.
+ */
+void init_xwayland(bool lazy);
 void init_layer_shell();
 
 std::string xwayland_get_display();
@@ -12,7 +12,9 @@
 #include "../output/gtk-shell.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include "wayfire/signal-definitions.hpp"
 
 static void reposition_relative_to_parent(wayfire_view view)
@@ -1046,6 +1048,191 @@ wf::region_t wf::view_interface_t::get_transformed_opaque_region()
     return opaque;
 }
 
+/**
+ * Calculate the matrix and color multiplier of the whole transformer chain of
+ * the view.
+ *
+ * @return false if any of the transformers cannot be fused.
+ */
+static bool get_fused_chain_transform(wf::view_interface_t *view,
+    glm::mat4& matrix, glm::vec4& color, bool& use_thumbnail)
+{
+    matrix = glm::mat4(1.0);
+    color  = glm::vec4(1.0);
+    use_thumbnail = false;
+
+    bool can_fuse = true;
+    bool first    = true;
+    auto box = view->get_untransformed_bounding_box();
+    view->view_impl->transforms.for_each([&] (auto& tr)
+    {
+        glm::mat4 tr_matrix;
+        glm::vec4 tr_color;
+        if (!can_fuse ||
+            !tr->transform->get_fused_transform(box, tr_matrix, tr_color))
+        {
+            can_fuse = false;
+
+            return;
+        }
+
+        if (!first)
+        {
+            /* See render_transformed() */
+            tr_matrix = tr_matrix * glm::scale(glm::mat4(1.0), {1, 1, 0});
+        }
+
+        matrix = tr_matrix * matrix;
+        color *= tr_color;
+        box    = tr->transform->get_bounding_box(box, box);
+        first  = false;
+        use_thumbnail |= tr->transform->use_thumbnail;
+    });
+
+    return can_fuse;
+}
+
+/**
+ * Transform a box with a matrix which keeps the box axis-aligned.
+ * The result is rounded inwards, so that it is fully covered by the real
+ * transformed box.
+ */
+static wlr_box transform_box_inner(const glm::mat4& matrix, wlr_box box)
+{
+    auto apply = [&] (float x, float y)
+    {
+        auto v = matrix * glm::vec4{x, y, 0, 1};
+        return glm::vec2{v.x / v.w, v.y / v.w};
+    };
+
+    auto p1 = apply(box.x, box.y);
+    auto p2 = apply(box.x + box.width, box.y + box.height);
+
+    int x1 = std::ceil(std::min(p1.x, p2.x));
+    int y1 = std::ceil(std::min(p1.y, p2.y));
+    int x2 = std::floor(std::max(p1.x, p2.x));
+    int y2 = std::floor(std::max(p1.y, p2.y));
+
+    return {x1, y1, std::max(0, x2 - x1), std::max(0, y2 - y1)};
+}
+
+/**
+ * Render the view from its snapshot, sampling it with mipmaps.
+ * The snapshot and the mipmaps are updated only if the view was damaged.
+ */
+static void render_thumbnail(wf::view_interface_t *view,
+    const wf::framebuffer_t& fb, const wf::region_t& damage,
+    const glm::mat4& matrix, const glm::vec4& color)
+{
+    view->take_snapshot();
+
+    auto& buffer = view->view_impl->offscreen_buffer;
+    OpenGL::render_begin(fb);
+    if (!buffer.has_mipmaps)
+    {
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
+        GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
+        buffer.has_mipmaps = true;
+    }
+
+    auto projection = fb.get_orthographic_projection() * matrix;
+    for (const auto& rect : damage)
+    {
+        fb.logic_scissor(wlr_box_from_pixman_box(rect));
+        OpenGL::render_transformed_texture(wf::texture_t{buffer.tex},
+            buffer.geometry, projection, color, OpenGL::TEXTURE_USE_MIPMAPS);
+    }
+
+    OpenGL::render_end();
+}
+
+/**
+ * Render each surface of a view directly to the framebuffer with the given
+ * matrix and color, without taking a snapshot of the view first.
+ *
+ * With a translucent color, this is only correct as long as no surface
+ * shines through another one. If the surfaces overlap in a way which would
+ * need the whole view to be blended as a group, nothing is rendered.
+ *
+ * @return Whether the view was rendered.
+ */
+static bool render_surfaces_directly(wf::view_interface_t *view,
+    const wf::framebuffer_t& fb, const wf::region_t& damage,
+    const glm::mat4& matrix, const glm::vec4& color)
+{
+    /* The matrix keeps boxes axis-aligned, so we can clip by opaque regions */
+    const bool axis_aligned = (matrix[1][0] == 0) && (matrix[0][1] == 0) &&
+        (matrix[0][3] == 0) && (matrix[1][3] == 0);
+    const bool translucent = (color.a < 1.0f);
+
+    auto og = view->get_output_geometry();
+    auto children = view->enumerate_surfaces({og.x, og.y});
+
+    /* Region which should not be painted for each surface, because an opaque
+     * surface above covers it. Only used with translucent color. */
+    std::vector<wf::region_t> covered(children.size());
+
+    wf::region_t surfaces_above, opaque_above;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        auto& child = children[i];
+        auto wlr_surf = child.surface->get_wlr_surface();
+        if (!wlr_surf || !wlr_surface_has_buffer(wlr_surf))
+        {
+            /* Surfaces which don't have a wlr_surface (i.e decorations) can
+             * render only themselves onto a framebuffer, so they need a
+             * snapshot. */
+            return false;
+        }
+
+        if (!translucent)
+        {
+            continue;
+        }
+
+        auto size = child.surface->get_size();
+        wlr_box box = {child.position.x, child.position.y,
+            size.width, size.height};
+
+        auto blended = (surfaces_above & box) ^ opaque_above;
+        if (!blended.empty() || (!axis_aligned && !(surfaces_above & box).empty()))
+        {
+            return false;
+        }
+
+        for (const auto& rect : opaque_above & box)
+        {
+            covered[i] |= transform_box_inner(matrix,
+                wlr_box_from_pixman_box(rect));
+        }
+
+        surfaces_above |= box;
+        opaque_above   |= child.surface->get_opaque_region(child.position);
+    }
+
+    auto projection = fb.get_orthographic_projection() * matrix;
+    OpenGL::render_begin(fb);
+    for (int i = children.size() - 1; i >= 0; i--)
+    {
+        auto& child = children[i];
+        auto size   = child.surface->get_size();
+        wf::texture_t texture{child.surface->get_wlr_surface()->buffer->texture};
+        wf::geometry_t geometry = {child.position.x, child.position.y,
+            size.width, size.height};
+
+        for (const auto& rect : damage ^ covered[i])
+        {
+            fb.logic_scissor(wlr_box_from_pixman_box(rect));
+            OpenGL::render_transformed_texture(texture, geometry,
+                projection, color);
+        }
+    }
+
+    OpenGL::render_end();
+
+    return true;
+}
+
 bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuffer,
     const wf::region_t& damage)
 {
@@ -1054,6 +1241,33 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
         return false;
     }
 
+    if (is_mapped())
+    {
+        /* If all transformers are simple matrices, try to render the surfaces
+         * one by one instead of taking a snapshot of the whole view. */
+        glm::mat4 matrix;
+        glm::vec4 color;
+        bool use_thumbnail;
+        if (get_fused_chain_transform(this, matrix, color, use_thumbnail))
+        {
+            auto bbox = get_bounding_box();
+            auto obox = get_untransformed_bounding_box();
+            if (use_thumbnail && OpenGL::supports_npot_mipmaps() &&
+                (bbox.width < obox.width) && (bbox.height < obox.height))
+            {
+                render_thumbnail(this, framebuffer, damage, matrix, color);
+
+                return true;
+            }
+
+            if (render_surfaces_directly(this, framebuffer, damage, matrix,
+                color))
+            {
+                return true;
+            }
+        }
+    }
+
     wf::geometry_t obox = get_untransformed_bounding_box();
     wf::texture_t previous_texture;
     float texture_scale;
@@ -1083,12 +1297,81 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
     /* final_transform is the one that should render to the screen */
     std::shared_ptr<view_transform_block_t> final_transform = nullptr;
 
+    /* Consecutive transformers which can be described by a matrix and a color
+     * multiplier are not rendered one by one. Instead, they are accumulated
+     * here and rendered in a single pass when a transformer which cannot be
+     * fused is reached, or directly to the target framebuffer at the end. */
+    struct
+    {
+        /* The last fused transform, its fb is used if we need to render the
+         * accumulated transforms offscreen */
+        std::shared_ptr<view_transform_block_t> last = nullptr;
+        glm::mat4 matrix{1.0};
+        glm::vec4 color{1.0};
+        /* Bounding box after the accumulated transforms */
+        wf::geometry_t box;
+    } fused;
+
+    auto flush_fused = [&] ()
+    {
+        if (!fused.last)
+        {
+            return;
+        }
+
+        int scaled_width  = fused.box.width * texture_scale;
+        int scaled_height = fused.box.height * texture_scale;
+
+        auto& fb = fused.last->fb;
+        OpenGL::render_begin();
+        fb.allocate(scaled_width, scaled_height);
+        fb.scale    = texture_scale;
+        fb.geometry = fused.box;
+        fb.bind();
+        OpenGL::clear({0, 0, 0, 0});
+        OpenGL::render_transformed_texture(previous_texture, obox,
+            fb.get_orthographic_projection() * fused.matrix, fused.color);
+        OpenGL::render_end();
+
+        previous_transform = fused.last;
+        previous_texture   = fb.tex;
+        obox = fused.box;
+
+        fused.last   = nullptr;
+        fused.matrix = glm::mat4(1.0);
+        fused.color  = glm::vec4(1.0);
+    };
+
     /* Render the view passing its snapshot through the transformers.
      * For each transformer except the last we render on offscreen buffers,
      * and the last one is rendered to the real fb. */
     auto& transforms = view_impl->transforms;
     transforms.for_each([&] (auto& transform) -> void
     {
+        auto input_box = fused.last ? fused.box : obox;
+
+        glm::mat4 matrix;
+        glm::vec4 color;
+        if (transform->transform->get_fused_transform(input_box, matrix, color))
+        {
+            if (fused.last)
+            {
+                /* The intermediate result is flat, so drop the Z coordinate
+                 * before applying the next transform. */
+                matrix = matrix * glm::scale(glm::mat4(1.0), {1, 1, 0});
+            }
+
+            fused.matrix = matrix * fused.matrix;
+            fused.color *= color;
+            fused.box    =
+                transform->transform->get_bounding_box(input_box, input_box);
+            fused.last = transform;
+
+            return;
+        }
+
+        flush_fused();
+
         /* Last transform is handled separately */
         if (transform == transforms.back())
         {
@@ -1121,17 +1404,18 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
         obox = transformed_box;
     });
 
-    /* This can happen in two ways:
+    /* This can happen in three ways:
      * 1. The view is unmapped, and no snapshot
      * 2. The last transform was deleted while iterating, so now the last
      *    transform is invalid in the list
+     * 3. The last transforms were fused
      *
-     * In both cases, we simply render whatever contents we have to the
-     * framebuffer. */
+     * In all cases, we simply render whatever contents we have to the
+     * framebuffer, applying the fused transforms (if any) on the way. */
     if (final_transform == nullptr)
     {
         OpenGL::render_begin(framebuffer);
-        auto matrix = framebuffer.get_orthographic_projection();
+        auto matrix = framebuffer.get_orthographic_projection() * fused.matrix;
         gl_geometry src_geometry = {
             1.0f * obox.x, 1.0f * obox.y,
             1.0f * obox.x + 1.0f * obox.width,
@@ -1142,7 +1426,7 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
         {
             framebuffer.logic_scissor(wlr_box_from_pixman_box(rect));
             OpenGL::render_transformed_texture(previous_texture, src_geometry,
-                {}, matrix);
+                {}, matrix, fused.color);
         }
 
         OpenGL::render_end();
@@ -1224,6 +1508,7 @@ void wf::view_interface_t::take_snapshot()
     }
 
     offscreen_buffer.cached_damage.clear();
+    offscreen_buffer.has_mipmaps = false;
 }
 
 wf::view_interface_t::view_interface_t()
@@ -1317,7 +1602,11 @@ void wf::view_damage_raw(wayfire_view view, const wlr_box& box)
         output->render->damage(box);
     }
 
-    view->emit_signal("region-damaged", nullptr);
+    view_region_damaged_signal data;
+    data.view = view;
+    data.box  = box;
+    view->emit_signal("region-damaged", &data);
+    output->emit_signal("view-region-damaged", &data);
 }
 
 void wf::view_interface_t::destruct()
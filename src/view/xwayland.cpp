@@ -22,10 +22,8 @@ class wayfire_xwayland_view_base : public wf::wlr_view_t
     static xcb_atom_t _NET_WM_WINDOW_TYPE_SPLASH;
 
     static void load_atom(xcb_connection_t *connection,
-        xcb_atom_t& atom, const std::string& name)
+        xcb_intern_atom_cookie_t cookie, xcb_atom_t& atom)
     {
-        auto cookie = xcb_intern_atom(connection, 0, name.length(), name.c_str());
-
         xcb_generic_error_t *error = NULL;
         xcb_intern_atom_reply_t *reply;
         reply = xcb_intern_atom_reply(connection, cookie, &error);
@@ -40,21 +38,35 @@ class wayfire_xwayland_view_base : public wf::wlr_view_t
         free(error);
     }
 
+    static xcb_intern_atom_cookie_t request_atom(xcb_connection_t *connection,
+        const std::string& name)
+    {
+        return xcb_intern_atom(connection, 0, name.length(), name.c_str());
+    }
+
   public:
+    /**
+     * Load the window type atoms. This is done synchronously when Xwayland is
+     * ready, because with lazy startup the client which started the server
+     * may map its windows right away, and they have to be classified
+     * correctly. All requests are sent before waiting for the replies, so this
+     * costs a single round-trip.
+     */
     static bool load_atoms(const char *server_name)
     {
         auto connection = xcb_connect(server_name, NULL);
         if (!connection || xcb_connection_has_error(connection))
         {
+            xcb_disconnect(connection);
             return false;
         }
 
-        load_atom(connection, _NET_WM_WINDOW_TYPE_NORMAL,
-            "_NET_WM_WINDOW_TYPE_NORMAL");
-        load_atom(connection, _NET_WM_WINDOW_TYPE_DIALOG,
-            "_NET_WM_WINDOW_TYPE_DIALOG");
-        load_atom(connection, _NET_WM_WINDOW_TYPE_SPLASH,
-            "_NET_WM_WINDOW_TYPE_SPLASH");
+        auto normal = request_atom(connection, "_NET_WM_WINDOW_TYPE_NORMAL");
+        auto dialog = request_atom(connection, "_NET_WM_WINDOW_TYPE_DIALOG");
+        auto splash = request_atom(connection, "_NET_WM_WINDOW_TYPE_SPLASH");
+        load_atom(connection, normal, _NET_WM_WINDOW_TYPE_NORMAL);
+        load_atom(connection, dialog, _NET_WM_WINDOW_TYPE_DIALOG);
+        load_atom(connection, splash, _NET_WM_WINDOW_TYPE_SPLASH);
 
         xcb_disconnect(connection);
         return true;
@@ -923,7 +935,7 @@ void wayfire_xwayland_view_base::recreate_view_with_or_type()
 static wlr_xwayland *xwayland_handle = nullptr;
 #endif
 
-void wf::init_xwayland()
+void wf::init_xwayland(bool lazy)
 {
 #if WF_HAS_XWAYLAND
     static wf::wl_listener_wrapper on_created;
@@ -951,7 +963,8 @@ void wf::init_xwayland()
 
     on_ready.set_callback([&] (void *data)
     {
-        if (!wayfire_xwayland_view_base::load_atoms(xwayland_handle->display_name))
+        if (!wayfire_xwayland_view_base::load_atoms(
+            xwayland_handle->display_name))
         {
             LOGE("Failed to load Xwayland atoms.");
         } else
@@ -965,7 +978,7 @@ void wf::init_xwayland()
     });
 
     xwayland_handle = wlr_xwayland_create(wf::get_core().display,
-        wf::get_core_impl().compositor, false);
+        wf::get_core_impl().compositor, lazy);
 
     if (xwayland_handle)
     {